@@ -53,116 +53,90 @@ float Sprite::getRadius() const {
 }
 
 // background class constructor; takes in position, scale, texture 
-Background::Background(sf::Vector2f position, sf::Vector2f scale, std::weak_ptr<sf::Texture> texture) : Sprite(position, scale, texture) {
-    if (auto tex = texture.lock()) {
-        spriteCreated = std::make_unique<sf::Sprite>(*tex);
-        spriteCreated->setScale(scale);
-        spriteCreated->setPosition(position.x, position.y); 
-
-        // initially position background sprite2 to the right side (off screen)
-        spriteCreated2 = std::make_unique<sf::Sprite>(*tex);
-        spriteCreated2->setScale(scale);
-        spriteCreated2->setPosition(position.x + tex->getSize().x * scale.x, position.y);
-
-        // initially position background sprite2 to the down side (off screen)
-        spriteCreated3 = std::make_unique<sf::Sprite>(*tex);
-        spriteCreated3->setScale(scale);
-        spriteCreated3->setPosition(position.x, position.y + tex->getSize().y * scale.y);
-
-        // initially position background sprite2 to the down side (off screen)
-        spriteCreated4 = std::make_unique<sf::Sprite>(*tex);
-        spriteCreated4->setScale(scale);
-        spriteCreated4->setPosition(position.x, position.y);
-
-        log_info("Background created");    
+Background::Background(sf::Vector2f position, sf::Vector2f scale, std::weak_ptr<sf::Texture> texture) 
+    : Background(position, std::vector<ParallaxLayer>{ ParallaxLayer{ texture, 1.0f, scale } }) {}
+
+// the first layer's texture doubles as the sprite's texture
+Background::Background(sf::Vector2f position, std::vector<ParallaxLayer> parallaxLayers) 
+    : Sprite(position, parallaxLayers.empty() ? sf::Vector2f(1.0f, 1.0f) : parallaxLayers.front().scale, parallaxLayers.empty() ? std::weak_ptr<sf::Texture>() : parallaxLayers.front().texture) {
+    for (auto& layer : parallaxLayers) addLayer(std::move(layer));
+    log_info("Background created with " + std::to_string(layers.size()) + " layers");    
+}
+
+void Background::addLayer(ParallaxLayer layer) {
+    auto texture = layer.texture.lock();
+    if (!texture || !texture->getSize().x || !texture->getSize().y) {
+        log_warning("\tskipped a background layer ( texture isn't loaded )");
+        return;
     }
+    if (layer.scale.x == 0.0f || layer.scale.y == 0.0f) {
+        log_warning("\tskipped a background layer ( scale is 0 )");
+        return;
+    }
+
+    texture->setRepeated(true); // the quad's texture coordinates run past the edges
+    layers.push_back(std::move(layer));
+    layerScroll.emplace_back(0.0f, 0.0f);
 }
  
-// Updates the background to move in a specified direction; need to fix it later cus the forth sprite doesn't wrap properly 
 void Background::updateBackground(float speed, SpriteComponents::Direction primaryDirection, SpriteComponents::Direction secondaryDirection) {
-    // Get the global bounds of the view
-    sf::FloatRect viewBounds(
-        MetaComponents::view.getCenter().x - MetaComponents::view.getSize().x / 2,
-        MetaComponents::view.getCenter().y - MetaComponents::view.getSize().y / 2,
-        MetaComponents::view.getSize().x,
-        MetaComponents::view.getSize().y
-    );
-        // Calculate the current movement offset based on speed, deltaTime
-    float offsetX = 0; // horizontal offset
-    float offsetY = 0; // vertical offset
-
-    // Set the offsets based on direction
-    if (primaryDirection == SpriteComponents::Direction::RIGHT) {
-        offsetX = -speed * MetaComponents::deltaTime;
-    } else if (primaryDirection == SpriteComponents::Direction::LEFT) {
-        offsetX = speed * MetaComponents::deltaTime;
-    } else if (primaryDirection == SpriteComponents::Direction::DOWN) {
-        offsetY = -speed * MetaComponents::deltaTime;
-    } else if (primaryDirection == SpriteComponents::Direction::UP) {
-        offsetY = speed * MetaComponents::deltaTime;
+    if (!backgroundMoveState) return;
+
+    // content moving right to left means the texture coordinates under the view go up
+    sf::Vector2f scroll {}; 
+    for (auto direction : { primaryDirection, secondaryDirection }) {
+        if (direction == SpriteComponents::Direction::RIGHT) scroll.x += speed * MetaComponents::deltaTime;
+        else if (direction == SpriteComponents::Direction::LEFT) scroll.x -= speed * MetaComponents::deltaTime;
+        else if (direction == SpriteComponents::Direction::DOWN) scroll.y += speed * MetaComponents::deltaTime;
+        else if (direction == SpriteComponents::Direction::UP) scroll.y -= speed * MetaComponents::deltaTime;
     }
 
-    // Calculate offset for secondary direction (if provided)
-    if (secondaryDirection == SpriteComponents::Direction::RIGHT) {
-        offsetX = -speed * MetaComponents::deltaTime;
-    } else if (secondaryDirection == SpriteComponents::Direction::LEFT) {
-        offsetX = speed * MetaComponents::deltaTime;
-    } else if (secondaryDirection == SpriteComponents::Direction::DOWN) {
-        offsetY = -speed * MetaComponents::deltaTime;
-    } else if (secondaryDirection == SpriteComponents::Direction::UP) {
-        offsetY = speed * MetaComponents::deltaTime;
+    // kept per layer in its own texture pixels and wrapped to the texture, so it stays small however long the game runs
+    for (size_t i = 0; i < layers.size(); ++i) {
+        auto texture = layers[i].texture.lock();
+        if (!texture) continue;
+        const sf::Vector2f textureSize(texture->getSize());
+        sf::Vector2f& offset = layerScroll[i];
+        offset.x = std::fmod(offset.x + scroll.x * layers[i].speedFactor / layers[i].scale.x, textureSize.x);
+        offset.y = std::fmod(offset.y + scroll.y * layers[i].speedFactor / layers[i].scale.y, textureSize.y);
     }
-
-    // Move all background sprites by the calculated offsets
-    spriteCreated->move(offsetX, offsetY);
-    spriteCreated2->move(offsetX, offsetY);
-    spriteCreated3->move(offsetX, offsetY);
-
-    float width = spriteCreated->getGlobalBounds().width; 
-    float height = spriteCreated->getGlobalBounds().height; 
-    sf::Vector2f position1 = spriteCreated->getPosition(); 
-    sf::Vector2f position2 = spriteCreated2->getPosition(); 
-    sf::Vector2f position3 = spriteCreated3->getPosition(); 
-    
-    // horizontal wrapping
-    if (position1.x + width < viewBounds.left) spriteCreated->setPosition(position2.x + width, position1.y);
-    if (position2.x + width < viewBounds.left) spriteCreated2->setPosition(position1.x + width, position2.y);
-    if (position1.x > viewBounds.left + viewBounds.width) spriteCreated->setPosition(position2.x - width, position1.y);
-    if (position2.x > viewBounds.left + viewBounds.width) spriteCreated2->setPosition(position1.x - width, position2.y);
-
-    // vertical wrapping 
-    if (position1.y + height < viewBounds.top) spriteCreated->setPosition(position1.x, position3.y + height);
-    if (position3.y + height < viewBounds.top) spriteCreated3->setPosition(position3.x, position1.y + height);
-    if (position1.y > viewBounds.top + viewBounds.height) spriteCreated->setPosition(position1.x, position3.y - height);
-    if (position3.y > viewBounds.top + viewBounds.height) spriteCreated3->setPosition(position3.x, position1.y - height);
-}
-
-sf::FloatRect Background::getViewBounds(sf::Sprite& spriteNum) const {
-    return {
-        spriteNum.getGlobalBounds().left, 
-        spriteNum.getGlobalBounds().width, 
-        spriteNum.getGlobalBounds().top, 
-        spriteNum.getGlobalBounds().height
-    }; 
 }
 
 void Background::draw(sf::RenderTarget& target, sf::RenderStates states) const {
-    if (visibleState) {
-        if (spriteCreated) {
-            target.draw(*spriteCreated, states);
-        }
-        if (spriteCreated2) {
-            target.draw(*spriteCreated2, states);
-        }
-        if (spriteCreated3) {
-            target.draw(*spriteCreated3, states);
-        }
-        // if (spriteCreated4) {
-        //     target.draw(*spriteCreated4, states);
-        // }
+    if (!visibleState) return;
+
+    sf::Vertex quad[4];
+    for (size_t i = 0; i < layers.size(); ++i) {
+        states.texture = getLayerQuad(i, target.getView(), quad);
+        if (states.texture) target.draw(quad, 4, sf::Quads, states);
     }
 }
 
+const sf::Texture* Background::getLayerQuad(size_t layerIndex, const sf::View& view, sf::Vertex* quad) const {
+    if (layerIndex >= layers.size()) return nullptr;
+    const ParallaxLayer& layer = layers[layerIndex];
+    auto texture = layer.texture.lock();
+    if (!texture) return nullptr;
+
+    const sf::Vector2f viewSize = view.getSize();
+    const sf::Vector2f topLeft = view.getCenter() - viewSize / 2.0f;
+    const sf::Vector2f bottomRight = topLeft + viewSize;
+    const sf::Vector2f textureSize(texture->getSize());
+
+    // texture pixel under the view's top left corner, wrapped to the texture so it stays small
+    sf::Vector2f textureOrigin((topLeft.x - position.x) * layer.speedFactor / layer.scale.x + layerScroll[layerIndex].x,
+                               (topLeft.y - position.y) * layer.speedFactor / layer.scale.y + layerScroll[layerIndex].y);
+    textureOrigin.x -= std::floor(textureOrigin.x / textureSize.x) * textureSize.x;
+    textureOrigin.y -= std::floor(textureOrigin.y / textureSize.y) * textureSize.y;
+    const sf::Vector2f textureEnd(textureOrigin.x + viewSize.x / layer.scale.x, textureOrigin.y + viewSize.y / layer.scale.y);
+
+    quad[0] = sf::Vertex(topLeft, textureOrigin);
+    quad[1] = sf::Vertex({ bottomRight.x, topLeft.y }, { textureEnd.x, textureOrigin.y });
+    quad[2] = sf::Vertex(bottomRight, textureEnd);
+    quad[3] = sf::Vertex({ topLeft.x, bottomRight.y }, { textureOrigin.x, textureEnd.y });
+    return texture.get(); // the texture is kept alive by whoever loaded it, the layer only holds a weak_ptr
+}
+
 // sets cut-out rect for sprite animation 
 void Animated::setRects(int animNum){
     try {
@@ -244,7 +218,7 @@ sf::IntRect Animated::getRects() const {
 }
 
 // returns bitmask for a sprite 
-std::shared_ptr<sf::Uint8[]> const Animated::getBitmask(size_t index) const {
+std::shared_ptr<Bitmask> const Animated::getBitmask(size_t index) const {
     try {
         if (index >= bitMask.size()) {
             throw std::out_of_range("Index out of range.");
@@ -315,5 +289,4 @@ void Bullet::setDirectionVector(sf::Vector2i projectionPos) {
         directionVector.x /= length;
         directionVector.y /= length;
     }
-    log_info("Bullet direction vector calculated.");
 }
@@ -11,6 +11,9 @@
 #include <iostream>
 #include <stdexcept>
 #include <map>
+#include <vector>
+#include <memory>
+#include <cmath>
 #include <SFML/Graphics.hpp>
 
 #include "../globals/globals.hpp"
@@ -26,6 +29,7 @@ public:
     sf::Sprite& returnSpritesShape() const { return *spriteCreated; } 
     bool getVisibleState() const { return visibleState; }
     void setVisibleState(bool VisibleState){ visibleState = VisibleState; }
+    bool isCentered() const { return centered; }
 
     // base template for retreaving radius (based on sprite size) 
     virtual float getRadius() const;
@@ -33,30 +37,34 @@ public:
     // blank members for use in Animated class
     virtual sf::IntRect getRects() const { return sf::IntRect(); }
     virtual int getCurrIndex() const { return 0; }
-    virtual std::shared_ptr<sf::Uint8[]> const getBitmask(size_t index) const { return nullptr; }
+    virtual std::shared_ptr<Bitmask> const getBitmask(size_t index) const { return nullptr; }
+    virtual std::shared_ptr<Bitmask> const getUnionBitmask() const { return nullptr; }
     virtual bool isAnimated() const { return false; }
     // blank members for use in NonStatic class
     virtual sf::Vector2f getDirectionVector() const { return sf::Vector2f(); }
     virtual float getSpeed() const { return 0.0f; }
     virtual sf::Vector2f getAcceleration() const { return sf::Vector2f(); }
-    bool getMoveState() const { return false; }
+    virtual bool getMoveState() const { return false; }
 
     // draws sprite using window.draw(*sprite)
     virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const override { if (visibleState && spriteCreated) target.draw(*spriteCreated, states); }
     virtual void updateVisibility(); 
 
 protected:
+    Sprite() : spriteCreated(std::make_unique<sf::Sprite>()) {} // no texture, for shapes that only ever get a rect (collision stand-ins)
+
     sf::Vector2f position {};
     sf::Vector2f scale {};
     std::weak_ptr<sf::Texture> texture;
     std::unique_ptr<sf::Sprite> spriteCreated;
     bool visibleState {};
+    bool centered {}; 
     float radius{}; 
 };
 
 class Animated : public virtual Sprite {
 public:
-    explicit Animated( sf::Vector2f position, sf::Vector2f scale, std::weak_ptr<sf::Texture> texture, const std::vector<sf::IntRect> animationRects, unsigned const int indexMax,  const std::vector<std::weak_ptr<sf::Uint8[]>>& bitMask) 
+    explicit Animated( sf::Vector2f position, sf::Vector2f scale, std::weak_ptr<sf::Texture> texture, const std::vector<sf::IntRect> animationRects, unsigned const int indexMax,  const std::vector<std::weak_ptr<Bitmask>>& bitMask) 
         : Sprite(position, scale, texture), animationRects(animationRects), indexMax(indexMax), bitMask(bitMask) {}
     std::vector<sf::IntRect> const getAnimationRects() const { return animationRects; } 
     void setAnimation(std::vector<sf::IntRect> AnimationRects) { animationRects = AnimationRects; } 
@@ -64,11 +72,15 @@ public:
     void setAnimChangeState(bool newState) { animChangeState = newState; }
     virtual void changeAnimation(); 
     void setRects(int animNum); 
+    // for systems::AnimationSystem, which already knows the rect. no bounds check, the index has to be in animationRects
+    void setFrame(int index, const sf::IntRect& rect) { currentIndex = index; if (spriteCreated) spriteCreated->setTextureRect(rect); }
 
     float getRadius() const override; 
     sf::IntRect getRects() const override;
     int getCurrIndex() const override { return currentIndex; } 
-    std::shared_ptr<sf::Uint8[]> const getBitmask(size_t index) const override; 
+    std::shared_ptr<Bitmask> const getBitmask(size_t index) const override; 
+    std::shared_ptr<Bitmask> const getUnionBitmask() const override { return unionBitMask.lock(); } 
+    void setUnionBitmask(std::weak_ptr<Bitmask> mask) { unionBitMask = mask; } // every frame ORed together, for frame independent rejection
     bool isAnimated() const override { return true; } // for checking type
 
 protected:
@@ -77,7 +89,8 @@ protected:
     int indexMax {}; 
     float elapsedTime {};
     bool animChangeState = true; 
-    std::vector<std::weak_ptr<sf::Uint8[]>> bitMask{}; 
+    std::vector<std::weak_ptr<Bitmask>> bitMask{}; 
+    std::weak_ptr<Bitmask> unionBitMask{}; 
 };
 
 class NonAnimated : public virtual Sprite { // add something inside later if necessary
@@ -85,32 +98,39 @@ class NonAnimated : public virtual Sprite { // add something inside later if nec
     ~NonAnimated() override{};
 };
 
-// background class deriving from sprites; the background doesn't "actually move with physics", but moves constantly to the left 
+// one layer of a parallax background. speedFactor is how much of the camera's movement and of the auto scroll the layer
+// follows: 0 stays stuck to the screen, 1 moves with the world, anything between looks further away
+struct ParallaxLayer {
+    std::weak_ptr<sf::Texture> texture;
+    float speedFactor = 1.0f;
+    sf::Vector2f scale { 1.0f, 1.0f };
+};
+
+// background class deriving from sprites; the background doesn't "actually move with physics", but scrolls constantly. every
+// layer is one quad over the view with a repeated texture, scrolling only moves the texture coordinates so it wraps in
+// both axes by itself. layers draw back to front
 class Background : public Sprite{
 public:
-   explicit Background(sf::Vector2f position, sf::Vector2f scale, std::weak_ptr<sf::Texture> texture);
+    explicit Background(sf::Vector2f position, sf::Vector2f scale, std::weak_ptr<sf::Texture> texture); // a single layer moving with the world
+    explicit Background(sf::Vector2f position, std::vector<ParallaxLayer> layers); 
     ~Background() override{};
 
-    // make background (can put any direction if only using primaryDirection, but need to put up/down in primary and right/left in secondary if using both)
-    void updateBackground(float speed, SpriteComponents::Direction primaryDirection, SpriteComponents::Direction secondaryDirection = SpriteComponents::Direction::NONE);  
-
-    sf::Sprite& returnSpritesShape2() { return *spriteCreated2; }
-    sf::Sprite& returnSpritesShape3() { return *spriteCreated3; }
-    sf::Sprite& returnSpritesShape4() { return *spriteCreated4; }
+    void addLayer(ParallaxLayer layer); // on top of the others
+    size_t getLayerCount() const { return layers.size(); }
 
-    sf::FloatRect getViewBounds(sf::Sprite& spriteNum) const;
+    // auto scroll; directions add up, so RIGHT + DOWN scrolls diagonally
+    void updateBackground(float speed, SpriteComponents::Direction primaryDirection, SpriteComponents::Direction secondaryDirection = SpriteComponents::Direction::NONE);  
 
     bool getBackgroundMoveState() const { return backgroundMoveState; } 
     void setBackgroundMoveState(bool newState) { backgroundMoveState = newState; }
     void draw(sf::RenderTarget& target, sf::RenderStates states) const override; 
 
+    // the 4 vertices draw() uses for a layer over the view; returns the layer's texture, null if it's gone (quad untouched)
+    const sf::Texture* getLayerQuad(size_t layerIndex, const sf::View& view, sf::Vertex* quad) const; 
+
 private:
-    // for right and left
-    std::unique_ptr<sf::Sprite> spriteCreated2;
-    // for up and down 
-    std::unique_ptr<sf::Sprite> spriteCreated3;
-    // for left-over blank space 
-    std::unique_ptr<sf::Sprite> spriteCreated4;
+    std::vector<ParallaxLayer> layers; 
+    std::vector<sf::Vector2f> layerScroll; // lines up with layers; texture pixels each has scrolled by, wrapped to its texture
 
     bool backgroundMoveState = true; 
 };
@@ -129,7 +149,7 @@ public:
         : Sprite(position, scale, texture), speed(speed), acceleration(acceleration) {}
     ~NonStatic() override{}; 
 
-    bool getMoveState() const { return moveState; }
+    bool getMoveState() const override { return moveState; }
     void setMoveState(bool newState) { moveState = newState; }
     void changePosition(sf::Vector2f newPos) { position = newPos; }  
     void setSpeed(float newSpeed) { speed = newSpeed; } 
@@ -156,7 +176,7 @@ class Player : public NonStatic, public Animated {
    explicit Player(sf::Vector2f position, sf::Vector2f scale, std::weak_ptr<sf::Texture> texture,
                 float speed, sf::Vector2f acceleration,  
                 const std::vector<sf::IntRect> animationRects, unsigned int indexMax, 
-                const std::vector<std::weak_ptr<sf::Uint8[]>>& bitMask)
+                const std::vector<std::weak_ptr<Bitmask>>& bitMask)
     : Sprite(position, scale, texture), 
       NonStatic(position, scale, texture, speed, acceleration), 
       Animated(position, scale, texture, animationRects, indexMax, bitMask) {}
@@ -182,7 +202,7 @@ public:
     explicit Obstacle(sf::Vector2f position, sf::Vector2f scale, std::weak_ptr<sf::Texture> texture, 
                       float speed, sf::Vector2f acceleration,  
                       const std::vector<sf::IntRect> animationRects, unsigned int indexMax, 
-                      const std::vector<std::weak_ptr<sf::Uint8[]>>& bitMask)
+                      const std::vector<std::weak_ptr<Bitmask>>& bitMask)
         : Sprite(position, scale, texture), 
           NonStatic(position, scale, texture, speed, acceleration), 
           Animated(position, scale, texture, animationRects, indexMax, bitMask) 
@@ -202,7 +222,7 @@ public:
    explicit Bullet(sf::Vector2f position, sf::Vector2f scale, std::weak_ptr<sf::Texture> texture, 
                     float speed, sf::Vector2f acceleration,  
                     const std::vector<sf::IntRect> animationRects, unsigned int indexMax, 
-                    const std::vector<std::weak_ptr<sf::Uint8[]>>& bitMask)
+                    const std::vector<std::weak_ptr<Bitmask>>& bitMask)
         : Sprite(position, scale, texture), 
           NonStatic(position, scale, texture, speed, acceleration), 
           Animated(position, scale, texture, animationRects, indexMax, bitMask) 
@@ -219,7 +239,7 @@ class Button : public Animated {
 public:
     explicit Button(sf::Vector2f position, sf::Vector2f scale, std::weak_ptr<sf::Texture> texture, 
                       const std::vector<sf::IntRect> animationRects, unsigned int indexMax, 
-                      const std::vector<std::weak_ptr<sf::Uint8[]>>& bitMask)
+                      const std::vector<std::weak_ptr<Bitmask>>& bitMask)
         : Sprite(position, scale, texture),
           Animated(position, scale, texture, animationRects, indexMax, bitMask)
     {}
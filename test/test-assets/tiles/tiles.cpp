@@ -1,7 +1,15 @@
 #include "tiles.hpp"
 
+#include <cstring>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 Tile::Tile(sf::Vector2f scale, std::weak_ptr<sf::Texture> texture, sf::IntRect textureRect, 
-           std::weak_ptr<sf::Uint8[]> bitmask, bool walkable)
+           std::weak_ptr<Bitmask> bitmask, bool walkable)
     : scale(scale), texture(texture), textureRect(textureRect), bitmask(bitmask), walkable(walkable) {
     
     try {
@@ -24,64 +32,74 @@ Tile::Tile(sf::Vector2f scale, std::weak_ptr<sf::Texture> texture, sf::IntRect t
     }
 }
 
-// Custom copy constructor
-Tile::Tile(const Tile& other)
-    : position(other.position), scale(other.scale),
-      texture(other.texture), textureRect(other.textureRect),
-      bitmask(other.bitmask), walkable(other.walkable) {
-
-    // Create a new sprite with the same texture and scale
-    tileSprite = std::make_unique<sf::Sprite>();
+ 
+bool MappedFile::open(const std::filesystem::path& filePath) {
+    close();
+#if defined(_WIN32)
+    (void)filePath;
+    return false; // no mmap here, callers fall back to reading the file
+#else
+    const int fileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) return false;
 
-    // Check if the texture is still valid
-    if (auto texturePtr = other.texture.lock()) {
-        // Set the texture and texture rectangle for the new sprite
-        tileSprite->setTexture(*texturePtr);
-        tileSprite->setTextureRect(other.textureRect);
-        tileSprite->setScale(scale); // Apply the scale
-        tileSprite->setPosition(other.tileSprite->getPosition()); // Copy the position if needed
-    } else {
-        throw std::runtime_error("Texture for copied tile is not available");
+    struct stat fileStat {};
+    if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size <= 0) {
+        ::close(fileDescriptor);
+        return false;
     }
+
+    // private + writable: pages are shared with the page cache until something writes to them
+    void* mapping = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fileDescriptor, 0);
+    ::close(fileDescriptor); // the mapping keeps the file alive
+    if (mapping == MAP_FAILED) return false;
+
+    bytes = static_cast<unsigned char*>(mapping);
+    length = static_cast<size_t>(fileStat.st_size);
+    return true;
+#endif
 }
- 
-TileMap::TileMap(std::shared_ptr<Tile>* tileTypesArray, unsigned int tileTypesNumber, size_t tileMapWidth, size_t tileMapHeight, float tileWidth, float tileHeight, std::filesystem::path filePath, sf::Vector2f tileMapPosition) 
+
+void MappedFile::close() {
+#if !defined(_WIN32)
+    if (bytes) munmap(bytes, length);
+#endif
+    bytes = nullptr;
+    length = 0;
+}
+
+TileMap::TileMap(std::shared_ptr<Tile>* tileTypesArray, unsigned int tileTypesNumber, size_t tileMapWidth, size_t tileMapHeight, float tileWidth, float tileHeight, std::filesystem::path filePath, sf::Vector2f tileMapPosition, std::optional<StreamingSettings> streamingSettings) 
     : tileTypesNumber(tileTypesNumber), tileMapWidth(tileMapWidth), tileMapHeight(tileMapHeight), tileWidth(tileWidth), tileHeight(tileHeight), tileMapPosition(tileMapPosition) {
 
     try{
-        tiles.reserve( tileMapWidth * tileMapHeight ); 
+        palette.assign(tileTypesArray, tileTypesArray + tileTypesNumber); 
 
-        std::ifstream fileStream(filePath);
-        
-        if (!fileStream.is_open()) {
-            throw std::runtime_error("Unable to open file: " + filePath.string());
+        std::filesystem::path binaryPath = filePath;
+        bool binaryUsable = true; 
+        if (filePath.extension() != ".tmap") {
+            binaryPath.replace_extension(".tmap");
+
+            std::error_code error;
+            const bool textExists = std::filesystem::exists(filePath, error);
+            // a cache left over from another map size would be rejected on every launch, so it's made again like an old one
+            const bool binaryStale = !std::filesystem::exists(binaryPath, error) || 
+                (textExists && std::filesystem::last_write_time(binaryPath, error) < std::filesystem::last_write_time(filePath, error)) ||
+                !binaryMatches(binaryPath, tileMapWidth, tileMapHeight);
+            binaryUsable = !binaryStale || (textExists && convertToBinary(filePath, binaryPath, tileMapWidth, tileMapHeight, tileTypesNumber));
         }
 
-        std::string line;
-        unsigned int currentY = 0; // Track the current row
+        if (streamingSettings && binaryUsable && startStreaming(binaryPath, *streamingSettings)) {
+            log_info("Tile map streaming from " + binaryPath.string());
+            return; 
+        }
 
-        while (std::getline(fileStream, line) && currentY < tileMapHeight) {
-            std::istringstream lineStream(line);
-            std::string tileIndexStr;
-            unsigned int currentX = 0; // Track the current column
+        ownedTileIds.assign(tileMapWidth * tileMapHeight, EMPTY_TILE); 
+        tileIds = ownedTileIds.data(); 
 
-            while (lineStream >> tileIndexStr && currentX < tileMapWidth) {
-                unsigned int tileIndex = std::stoul(tileIndexStr); // Convert to unsigned int
-                
-                if (tileIndex < tileTypesNumber) {
-                    auto tile = tileTypesArray[tileIndex]->clone();
-                    tile->getTileSprite().setPosition(tileMapPosition.x + currentX * tileWidth, tileMapPosition.y + currentY * tileHeight); 
-                    tiles.emplace_back(std::move(tile));
-                    
-                } else {
-                    throw std::out_of_range("Tile index out of bounds: " + std::to_string(tileIndex));
-                }
-                currentX++; // Increment column index
-            } 
-            currentY++; // Increment row index
-        }
+        const bool loaded = binaryUsable && loadFromBinary(binaryPath); 
+        if (!loaded) loadFromText(filePath); 
 
-        fileStream.close();
+        rebuildSolidity(); 
+        buildChunks(); 
 
         log_info("Tile map initialized successfully");
     } catch (const std::exception& e) {
@@ -89,35 +107,697 @@ TileMap::TileMap(std::shared_ptr<Tile>* tileTypesArray, unsigned int tileTypesNu
     }
 }
 
+std::vector<uint16_t> TileMap::readTextGrid(const std::filesystem::path& filePath, size_t tileMapWidth, size_t tileMapHeight, unsigned int idLimit) {
+    std::vector<uint16_t> ids(tileMapWidth * tileMapHeight, EMPTY_TILE);
+    std::ifstream fileStream(filePath);
+    
+    if (!fileStream.is_open()) {
+        throw std::runtime_error("Unable to open file: " + filePath.string());
+    }
+
+    std::string line;
+    unsigned int currentY = 0; // Track the current row
+
+    while (std::getline(fileStream, line) && currentY < tileMapHeight) {
+        std::istringstream lineStream(line);
+        std::string tileIndexStr;
+        unsigned int currentX = 0; // Track the current column
+
+        while (lineStream >> tileIndexStr && currentX < tileMapWidth) {
+            unsigned int tileIndex = std::stoul(tileIndexStr); // Convert to unsigned int
+            
+            if (tileIndex < idLimit && tileIndex < EMPTY_TILE) {
+                ids[currentY * tileMapWidth + currentX] = static_cast<uint16_t>(tileIndex);
+            } else {
+                throw std::out_of_range("Tile index out of bounds: " + std::to_string(tileIndex));
+            }
+            currentX++; // Increment column index
+        } 
+        currentY++; // Increment row index
+    }
+
+    fileStream.close();
+    return ids;
+}
+
+void TileMap::loadFromText(const std::filesystem::path& filePath) {
+    mappedFile.close(); 
+    ownedTileIds.assign(tileMapWidth * tileMapHeight, EMPTY_TILE); // stays empty if the file is bad
+    tileIds = ownedTileIds.data(); 
+
+    ownedTileIds = readTextGrid(filePath, tileMapWidth, tileMapHeight, tileTypesNumber); 
+    tileIds = ownedTileIds.data(); 
+    log_info("Tile map read from text: " + filePath.string());
+}
+
+bool TileMap::loadFromBinary(const std::filesystem::path& filePath) {
+    if (!mappedFile.open(filePath)) {
+        log_warning("Unable to map tile map file: " + filePath.string());
+        return false;
+    }
+
+    unsigned char* bytes = mappedFile.data();
+    const size_t fileSize = mappedFile.size();
+    const size_t cellCount = tileMapWidth * tileMapHeight;
+
+    BinaryHeader header {};
+    std::string problem; 
+    if (fileSize < sizeof(BinaryHeader)) {
+        problem = "file too small";
+    } else {
+        std::memcpy(&header, bytes, sizeof(BinaryHeader));
+        const size_t gridOffset = sizeof(BinaryHeader) + static_cast<size_t>(header.paletteSize) * sizeof(uint16_t);
+
+        if (std::memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0) problem = "not a tile map file";
+        else if (header.version != BINARY_VERSION) problem = "unsupported version " + std::to_string(header.version);
+        else if (header.width != tileMapWidth || header.height != tileMapHeight) {
+            problem = "size " + std::to_string(header.width) + "x" + std::to_string(header.height) + " doesn't match the config";
+        }
+        else if (gridOffset + header.gridBytes > fileSize) problem = "truncated";
+        else if (!(header.flags & BINARY_FLAG_RLE) && header.gridBytes != cellCount * sizeof(uint16_t)) problem = "grid size mismatch";
+        else if ((header.flags & BINARY_FLAG_RLE) && header.gridBytes % (2 * sizeof(uint16_t)) != 0) problem = "bad run data";
+    }
+    if (!problem.empty()) {
+        mappedFile.close();
+        log_warning("Rejected tile map file " + filePath.string() + ": " + problem);
+        return false;
+    }
+
+    // header is 24 bytes and the palette is uint16s, so the grid is always 2 byte aligned in the (page aligned) mapping
+    const uint16_t* filePalette = reinterpret_cast<const uint16_t*>(bytes + sizeof(BinaryHeader));
+    uint16_t* grid = reinterpret_cast<uint16_t*>(bytes + sizeof(BinaryHeader) + header.paletteSize * sizeof(uint16_t));
+
+    bool identityPalette = true; 
+    for (uint32_t index = 0; index < header.paletteSize && identityPalette; ++index) identityPalette = filePalette[index] == index;
+
+    // decoding turns ids past the palette into EMPTY_TILE, so the grid can only be used as is if it has none
+    auto inPalette = [&header](uint16_t fileId) { return fileId < header.paletteSize || fileId == EMPTY_TILE; };
+    if (identityPalette && !(header.flags & BINARY_FLAG_RLE) && std::all_of(grid, grid + cellCount, inPalette)) {
+        tileIds = grid; // zero-copy, addTile() writes land on private copies of the pages
+        ownedTileIds.clear(); 
+        ownedTileIds.shrink_to_fit(); 
+        log_info("Tile map mapped from " + filePath.string());
+        return true;
+    }
+
+    auto toTileId = [&](uint16_t fileId) -> uint16_t {
+        return fileId < header.paletteSize ? filePalette[fileId] : EMPTY_TILE;
+    };
+
+    ownedTileIds.assign(cellCount, EMPTY_TILE);
+    if (header.flags & BINARY_FLAG_RLE) {
+        const size_t runCount = header.gridBytes / (2 * sizeof(uint16_t));
+        size_t cell = 0; 
+        for (size_t run = 0; run < runCount; ++run) {
+            const size_t runLength = grid[run * 2];
+            if (runLength > cellCount - cell) {
+                mappedFile.close();
+                ownedTileIds.assign(cellCount, EMPTY_TILE);
+                tileIds = ownedTileIds.data();
+                log_warning("Rejected tile map file " + filePath.string() + ": runs overflow the grid");
+                return false;
+            }
+            std::fill_n(ownedTileIds.begin() + cell, runLength, toTileId(grid[run * 2 + 1]));
+            cell += runLength;
+        }
+    } else {
+        std::transform(grid, grid + cellCount, ownedTileIds.begin(), toTileId);
+    }
+
+    mappedFile.close(); // decoded, the file isn't needed anymore
+    tileIds = ownedTileIds.data(); 
+    log_info("Tile map decoded from " + filePath.string());
+    return true;
+}
+
+bool TileMap::binaryMatches(const std::filesystem::path& filePath, size_t tileMapWidth, size_t tileMapHeight) {
+    std::ifstream fileStream(filePath, std::ios::binary);
+    BinaryHeader header {};
+    if (!fileStream.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+
+    return std::memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0 && header.version == BINARY_VERSION &&
+           header.width == tileMapWidth && header.height == tileMapHeight;
+}
+
+bool TileMap::convertToBinary(const std::filesystem::path& textPath, const std::filesystem::path& binaryPath, size_t tileMapWidth, size_t tileMapHeight, unsigned int tileTypesNumber, bool compress) {
+    try {
+        if (tileMapWidth > UINT32_MAX || tileMapHeight > UINT32_MAX) {
+            throw std::out_of_range("Tile map too large for the binary format");
+        }
+        const std::vector<uint16_t> ids = readTextGrid(textPath, tileMapWidth, tileMapHeight, tileTypesNumber);
+
+        uint16_t paletteSize = 0; // identity palette up to the largest id used
+        for (uint16_t id : ids) {
+            if (id != EMPTY_TILE) paletteSize = std::max<uint16_t>(paletteSize, id + 1);
+        }
+        std::vector<uint16_t> filePalette(paletteSize);
+        for (uint16_t index = 0; index < paletteSize; ++index) filePalette[index] = index;
+
+        std::vector<uint16_t> grid;
+        if (compress) {
+            for (size_t cell = 0; cell < ids.size(); ) {
+                size_t runLength = 1;
+                while (cell + runLength < ids.size() && ids[cell + runLength] == ids[cell] && runLength < UINT16_MAX) ++runLength;
+                grid.push_back(static_cast<uint16_t>(runLength));
+                grid.push_back(ids[cell]);
+                cell += runLength;
+            }
+        } else {
+            grid = ids;
+        }
+
+        BinaryHeader header {};
+        std::memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+        header.version = BINARY_VERSION;
+        header.flags = compress ? BINARY_FLAG_RLE : 0;
+        header.width = static_cast<uint32_t>(tileMapWidth);
+        header.height = static_cast<uint32_t>(tileMapHeight);
+        header.paletteSize = paletteSize;
+        header.gridBytes = static_cast<uint32_t>(grid.size() * sizeof(uint16_t));
+
+        // written next to the target and renamed over it, so a half written file is never picked up as the cache
+        std::filesystem::path tempPath = binaryPath;
+        tempPath += ".tmp";
+        {
+            std::ofstream fileStream(tempPath, std::ios::binary | std::ios::trunc);
+            if (!fileStream.is_open()) {
+                throw std::runtime_error("Unable to open file: " + tempPath.string());
+            }
+            fileStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            fileStream.write(reinterpret_cast<const char*>(filePalette.data()), filePalette.size() * sizeof(uint16_t));
+            fileStream.write(reinterpret_cast<const char*>(grid.data()), grid.size() * sizeof(uint16_t));
+            if (!fileStream) {
+                throw std::runtime_error("Failed writing file: " + tempPath.string());
+            }
+        }
+        std::filesystem::rename(tempPath, binaryPath);
+
+        log_info("Converted tile map " + textPath.string() + " to " + binaryPath.string());
+        return true;
+    } catch (const std::exception& e) {
+        log_warning("Error in converting tile map: " + std::string(e.what()));
+        return false;
+    }
+}
+
 void TileMap::draw(sf::RenderTarget& target, sf::RenderStates states) const {
-    for (const auto& tile : tiles) {
-        if (tile) {
-            target.draw(tile->getTileSprite(), states);
+    auto texture = tilesetTexture.lock();
+    if (!texture) return; // nothing loaded
+
+    // visible world rect, pulled back into map space through the states' transform
+    const sf::View& view = target.getView();
+    sf::FloatRect viewRect(view.getCenter() - view.getSize() / 2.0f, view.getSize());
+    viewRect = states.transform.getInverse().transformRect(viewRect);
+
+    drawStats = DrawStats{};
+    states.texture = texture.get();
+    drawStats.drawnChunks = forEachVisibleChunk(viewRect, [&](const sf::VertexArray& chunk) {
+        target.draw(chunk, states);
+        drawStats.drawnTiles += chunk.getVertexCount() / 4;
+    });
+    drawStats.culledChunks = getChunkCount() - drawStats.drawnChunks;
+}
+
+size_t TileMap::forEachVisibleChunk(const sf::FloatRect& area, const std::function<void(const sf::VertexArray& chunk)>& visit) const {
+    if (!streaming && chunks.empty()) return 0; 
+
+    const sf::IntRect cells = getCellRange(area);
+    if (cells.width <= 0 || cells.height <= 0) return 0;
+    const size_t firstChunkX = static_cast<size_t>(cells.left) / CHUNK_SIZE;
+    const size_t firstChunkY = static_cast<size_t>(cells.top) / CHUNK_SIZE;
+    const size_t lastChunkX = static_cast<size_t>(cells.left + cells.width - 1) / CHUNK_SIZE;
+    const size_t lastChunkY = static_cast<size_t>(cells.top + cells.height - 1) / CHUNK_SIZE;
+
+    size_t visited = 0;
+    for (size_t chunkY = firstChunkY; chunkY <= lastChunkY; ++chunkY) {
+        for (size_t chunkX = firstChunkX; chunkX <= lastChunkX; ++chunkX) {
+            const size_t chunkIndex = chunkY * chunkColumns + chunkX;
+            const sf::VertexArray* chunk = nullptr;
+            if (streaming) { // chunks still loading are just skipped
+                auto found = residentChunks.find(chunkIndex);
+                if (found == residentChunks.end()) continue;
+                chunk = &found->second.vertices;
+            } else {
+                chunk = &chunks[chunkIndex];
+            }
+            visit(*chunk);
+            ++visited;
         }
     }
+    return visited;
+}
+
+void TileMap::drawChunk(sf::RenderTarget& target, size_t chunkIndex, sf::RenderStates states) const {
+    auto texture = tilesetTexture.lock();
+    if (!texture || chunkIndex >= getChunkCount()) return;
+
+    const sf::VertexArray* chunk = nullptr;
+    if (streaming) {
+        auto found = residentChunks.find(chunkIndex);
+        if (found == residentChunks.end()) return;
+        chunk = &found->second.vertices;
+    } else {
+        if (chunkIndex >= chunks.size()) return;
+        chunk = &chunks[chunkIndex];
+    }
+    states.texture = texture.get();
+    target.draw(*chunk, states);
+}
+
+void TileMap::buildChunks() {
+    chunkColumns = (tileMapWidth + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunkRows = (tileMapHeight + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunks.clear();
+    chunks.reserve(chunkColumns * chunkRows);
+
+    for (size_t chunkY = 0; chunkY < chunkRows; ++chunkY) {
+        for (size_t chunkX = 0; chunkX < chunkColumns; ++chunkX) { // chunks on the right and bottom edges can be smaller
+            const size_t width = std::min(CHUNK_SIZE, tileMapWidth - chunkX * CHUNK_SIZE);
+            const size_t height = std::min(CHUNK_SIZE, tileMapHeight - chunkY * CHUNK_SIZE);
+            chunks.emplace_back(sf::Quads, width * height * 4);
+        }
+    }
+    findTilesetTexture(); 
+
+    for (size_t y = 0; y < tileMapHeight; ++y) {
+        for (size_t x = 0; x < tileMapWidth; ++x) updateTileVertices(x, y);
+    }
+    log_info("Tile map split into " + std::to_string(chunks.size()) + " chunks");
+}
+
+void TileMap::findTilesetTexture() {
+    for (const auto& tileType : palette) {
+        if (tileType && tileType->getTexture().lock()) {
+            tilesetTexture = tileType->getTexture();
+            break;
+        }
+    }
+}
+
+void TileMap::updateTileVertices(size_t x, size_t y) {
+    const size_t chunkX = x / CHUNK_SIZE;
+    const size_t chunkY = y / CHUNK_SIZE;
+    sf::Vertex* quad = &chunks[chunkY * chunkColumns + chunkX][((y % CHUNK_SIZE) * chunkWidth(chunkX) + x % CHUNK_SIZE) * 4];
+    writeTileQuad(quad, x, y, tileIds[y * tileMapWidth + x]);
+}
+
+// quad matches what the tile's sprite would draw; missing tiles get a zero sized quad
+void TileMap::writeTileQuad(sf::Vertex* quad, size_t x, size_t y, uint16_t tileId) const {
+    const Tile* tile = getTileType(tileId);
+    if (!tile) {
+        for (int corner = 0; corner < 4; ++corner) quad[corner] = sf::Vertex();
+        return;
+    }
+
+    const sf::IntRect rect = tile->getTextureRect();
+    const sf::Vector2f scale = tile->getScale();
+    const sf::Vector2f topLeft(tileMapPosition.x + x * tileWidth, tileMapPosition.y + y * tileHeight);
+    const sf::Vector2f size(rect.width * scale.x, rect.height * scale.y);
+    const float left = static_cast<float>(rect.left);
+    const float top = static_cast<float>(rect.top);
+    const float right = static_cast<float>(rect.left + rect.width);
+    const float bottom = static_cast<float>(rect.top + rect.height);
+
+    quad[0].position = topLeft;
+    quad[1].position = { topLeft.x + size.x, topLeft.y };
+    quad[2].position = topLeft + size;
+    quad[3].position = { topLeft.x, topLeft.y + size.y };
+
+    quad[0].texCoords = { left, top };
+    quad[1].texCoords = { right, top };
+    quad[2].texCoords = { right, bottom };
+    quad[3].texCoords = { left, bottom };
 }
 
 // Add a tile to the map at the specified grid position (x, y)
-void TileMap::addTile(unsigned int x, unsigned int y, std::unique_ptr<Tile> tile) {
+void TileMap::addTile(unsigned int x, unsigned int y, uint16_t tileId) {
     try{
         if (x >= tileMapWidth || y >= tileMapHeight) {
             throw std::out_of_range("Tile position out of bounds: (" + std::to_string(x) + ", " + std::to_string(y) + ")");
         }
+        if (tileId != EMPTY_TILE && tileId >= palette.size()) {
+            throw std::out_of_range("Tile id out of bounds: " + std::to_string(tileId));
+        }
 
-        // Calculate the index in the tiles vector
-        unsigned int index = y * tileMapWidth + x;
+        const Tile* tile = getTileType(tileId);
+        const bool solid = tile && !tile->getWalkable();
 
-        // Ensure the tile is valid (not nullptr)
-        if (!tile) {
-            throw std::runtime_error("Attempted to add a null tile.");
-        }
+        if (streaming) {
+            auto found = residentChunks.find((y / CHUNK_SIZE) * chunkColumns + x / CHUNK_SIZE);
+            if (found == residentChunks.end()) {
+                throw std::out_of_range("Tile chunk isn't loaded: (" + std::to_string(x) + ", " + std::to_string(y) + ")");
+            }
+            StreamedChunk& chunk = found->second;
+            const size_t localX = x % CHUNK_SIZE;
+            const size_t localY = y % CHUNK_SIZE;
+            const size_t localIndex = localY * chunkWidth(x / CHUNK_SIZE) + localX;
 
-        // Move the tile into the tiles vector at the calculated index
-        tiles[index] = std::move(tile);
+            chunk.tileIds[localIndex] = tileId;
+            chunk.solidRows[localY] = solid ? (chunk.solidRows[localY] | uint64_t(1) << localX) : (chunk.solidRows[localY] & ~(uint64_t(1) << localX));
+            writeTileQuad(&chunk.vertices[localIndex * 4], x, y, tileId);
+            chunk.edited = true;
+            if (chunkChanged) chunkChanged(found->first);
+            return;
+        }
 
-        // Optionally set the position of the tile if the Tile class has a method for that
-        tiles[index]->getTileSprite().setPosition(tileMapPosition.x + x * tileWidth, tileMapPosition.y + y * tileHeight);
+        tileIds[y * tileMapWidth + x] = tileId;
+        setSolid(x, y, solid);
+        if (!chunks.empty()) updateTileVertices(x, y);
+        if (chunkChanged) chunkChanged((y / CHUNK_SIZE) * chunkColumns + x / CHUNK_SIZE);
     } catch (const std::exception& e) {
         log_error(e.what()); // Log any exceptions that occur
     }
 }
+
+void TileMap::rebuildSolidity() {
+    solidRowWords = (tileMapWidth + 63) / 64;
+    solidCells.assign(solidRowWords * tileMapHeight, 0);
+
+    for (size_t index = 0; index < tileMapWidth * tileMapHeight; ++index) {
+        const Tile* tile = getTileType(tileIds[index]);
+        if (tile && !tile->getWalkable()) setSolid(index % tileMapWidth, index / tileMapWidth, true);
+    }
+}
+
+void TileMap::setSolid(size_t x, size_t y, bool solid) {
+    uint64_t& word = solidCells[y * solidRowWords + x / 64];
+    const uint64_t bit = uint64_t(1) << (x % 64);
+    word = solid ? (word | bit) : (word & ~bit);
+}
+
+uint16_t TileMap::getTileId(size_t x, size_t y) const {
+    if (x >= tileMapWidth || y >= tileMapHeight) return EMPTY_TILE;
+    if (streaming) {
+        const StreamedChunk* chunk = findResidentChunk(x, y);
+        return chunk ? chunk->tileIds[(y % CHUNK_SIZE) * chunkWidth(x / CHUNK_SIZE) + x % CHUNK_SIZE] : EMPTY_TILE;
+    }
+    return tileIds ? tileIds[y * tileMapWidth + x] : EMPTY_TILE;
+}
+
+bool TileMap::isSolid(size_t x, size_t y) const {
+    if (x >= tileMapWidth || y >= tileMapHeight) return false;
+    if (streaming) {
+        const StreamedChunk* chunk = findResidentChunk(x, y);
+        return chunk && ((chunk->solidRows[y % CHUNK_SIZE] >> (x % CHUNK_SIZE)) & 1u);
+    }
+    if (solidCells.empty()) return false;
+    return (solidCells[y * solidRowWords + x / 64] >> (x % 64)) & 1u;
+}
+
+// edges that only touch the next cell don't count as overlapping it, same as sf::FloatRect::intersects
+sf::IntRect TileMap::getCellRange(const sf::FloatRect& bounds) const {
+    if (tileWidth <= 0.0f || tileHeight <= 0.0f || bounds.width <= 0.0f || bounds.height <= 0.0f) return {};
+
+    const float firstX = std::floor((bounds.left - tileMapPosition.x) / tileWidth);
+    const float firstY = std::floor((bounds.top - tileMapPosition.y) / tileHeight);
+    const float lastX = std::ceil((bounds.left + bounds.width - tileMapPosition.x) / tileWidth) - 1.0f;
+    const float lastY = std::ceil((bounds.top + bounds.height - tileMapPosition.y) / tileHeight) - 1.0f;
+
+    const float left = std::max(firstX, 0.0f);
+    const float top = std::max(firstY, 0.0f);
+    const float right = std::min(lastX, static_cast<float>(tileMapWidth) - 1.0f);
+    const float bottom = std::min(lastY, static_cast<float>(tileMapHeight) - 1.0f);
+    if (left > right || top > bottom) return {};
+
+    return { static_cast<int>(left), static_cast<int>(top), static_cast<int>(right - left) + 1, static_cast<int>(bottom - top) + 1 };
+}
+
+bool TileMap::overlapsSolid(const sf::FloatRect& bounds) const {
+    const sf::IntRect cells = getCellRange(bounds);
+    if (cells.width <= 0 || cells.height <= 0) return false;
+
+    const size_t firstX = static_cast<size_t>(cells.left);
+    const size_t lastX = firstX + static_cast<size_t>(cells.width) - 1;
+    if (streaming) { // a row of a chunk is one word, same masking per chunk
+        for (size_t y = static_cast<size_t>(cells.top); y < static_cast<size_t>(cells.top + cells.height); ++y) {
+            for (size_t chunkX = firstX / CHUNK_SIZE; chunkX <= lastX / CHUNK_SIZE; ++chunkX) {
+                auto found = residentChunks.find((y / CHUNK_SIZE) * chunkColumns + chunkX);
+                if (found == residentChunks.end()) continue;
+
+                const size_t localFirst = std::max(firstX, chunkX * CHUNK_SIZE) - chunkX * CHUNK_SIZE;
+                const size_t localLast = std::min(lastX, chunkX * CHUNK_SIZE + CHUNK_SIZE - 1) - chunkX * CHUNK_SIZE;
+                const uint64_t mask = (~uint64_t(0) << localFirst) & (~uint64_t(0) >> (63 - localLast));
+                if (found->second.solidRows[y % CHUNK_SIZE] & mask) return true;
+            }
+        }
+        return false;
+    }
+    if (solidCells.empty()) return false;
+    for (size_t y = static_cast<size_t>(cells.top); y < static_cast<size_t>(cells.top + cells.height); ++y) {
+        const uint64_t* row = solidCells.data() + y * solidRowWords;
+        for (size_t word = firstX / 64; word <= lastX / 64; ++word) { // whole words at a time, masked down to the cell range
+            uint64_t mask = ~uint64_t(0);
+            if (word == firstX / 64) mask &= ~uint64_t(0) << (firstX % 64);
+            if (word == lastX / 64) mask &= ~uint64_t(0) >> (63 - lastX % 64);
+            if (row[word] & mask) return true;
+        }
+    }
+    return false;
+}
+
+bool TileMap::overlapsUnloaded(const sf::FloatRect& bounds) const {
+    if (!streaming) return false;
+    const sf::IntRect cells = getCellRange(bounds);
+    if (cells.width <= 0 || cells.height <= 0) return false;
+
+    const size_t lastX = static_cast<size_t>(cells.left + cells.width - 1);
+    const size_t lastY = static_cast<size_t>(cells.top + cells.height - 1);
+    for (size_t chunkY = static_cast<size_t>(cells.top) / CHUNK_SIZE; chunkY <= lastY / CHUNK_SIZE; ++chunkY) {
+        for (size_t chunkX = static_cast<size_t>(cells.left) / CHUNK_SIZE; chunkX <= lastX / CHUNK_SIZE; ++chunkX) {
+            if (!residentChunks.count(chunkY * chunkColumns + chunkX)) return true;
+        }
+    }
+    return false;
+}
+
+TileMap::~TileMap() {
+    stopStreaming(); 
+}
+
+const TileMap::StreamedChunk* TileMap::findResidentChunk(size_t x, size_t y) const {
+    auto found = residentChunks.find((y / CHUNK_SIZE) * chunkColumns + x / CHUNK_SIZE);
+    return found == residentChunks.end() ? nullptr : &found->second;
+}
+
+size_t TileMap::chunkBytes(size_t chunkIndex) const {
+    const size_t tiles = chunkWidth(chunkIndex % chunkColumns) * chunkHeight(chunkIndex / chunkColumns);
+    return sizeof(StreamedChunk) + tiles * (sizeof(uint16_t) + 4 * sizeof(sf::Vertex));
+}
+
+// only reads the header and palette here, chunks come in through streamLoop()
+bool TileMap::startStreaming(const std::filesystem::path& binaryPath, const StreamingSettings& settings) {
+    std::ifstream fileStream(binaryPath, std::ios::binary);
+    if (!fileStream.is_open()) {
+        log_warning("Unable to stream tile map file: " + binaryPath.string());
+        return false;
+    }
+
+    BinaryHeader header {};
+    fileStream.read(reinterpret_cast<char*>(&header), sizeof(header));
+    const size_t gridOffset = sizeof(BinaryHeader) + static_cast<size_t>(header.paletteSize) * sizeof(uint16_t);
+    const size_t cellCount = static_cast<size_t>(header.width) * header.height;
+
+    std::error_code error;
+    const uintmax_t fileSize = std::filesystem::file_size(binaryPath, error);
+
+    std::string problem; 
+    if (!fileStream || std::memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0) problem = "not a tile map file";
+    else if (header.version != BINARY_VERSION) problem = "unsupported version " + std::to_string(header.version);
+    else if (header.flags & BINARY_FLAG_RLE) problem = "run-length encoded maps can't be read a chunk at a time";
+    else if (cellCount == 0 || header.gridBytes != cellCount * sizeof(uint16_t)) problem = "grid size mismatch";
+    else if (error || gridOffset + header.gridBytes > fileSize) problem = "truncated";
+
+    if (problem.empty()) {
+        streamPalette.resize(header.paletteSize);
+        fileStream.read(reinterpret_cast<char*>(streamPalette.data()), streamPalette.size() * sizeof(uint16_t));
+        if (!fileStream) problem = "truncated palette";
+    }
+    if (!problem.empty()) {
+        streamPalette.clear();
+        log_warning("Can't stream tile map file " + binaryPath.string() + ": " + problem);
+        return false;
+    }
+
+    if (header.width != tileMapWidth || header.height != tileMapHeight) {
+        log_info("Streamed tile map is " + std::to_string(header.width) + "x" + std::to_string(header.height) + ", not the configured size");
+    }
+    tileMapWidth = header.width;
+    tileMapHeight = header.height;
+    chunkColumns = (tileMapWidth + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunkRows = (tileMapHeight + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    streamSettings = settings;
+    streamSettings.evictRadius = std::max(settings.evictRadius, settings.loadRadius);
+    streamPath = binaryPath;
+    streamGridOffset = gridOffset;
+    findTilesetTexture(); 
+
+    streaming = true;
+    streamThread = std::thread(&TileMap::streamLoop, this);
+    return true;
+}
+
+void TileMap::stopStreaming() {
+    if (!streamThread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        streamStop = true;
+    }
+    streamCondition.notify_all();
+    streamThread.join();
+}
+
+void TileMap::streamLoop() {
+    std::ifstream fileStream(streamPath, std::ios::binary); // own handle, so seeking never races anything
+
+    while (true) {
+        size_t chunkIndex; 
+        {
+            std::unique_lock<std::mutex> lock(streamMutex);
+            streamCondition.wait(lock, [this] { return streamStop || !streamRequests.empty(); });
+            if (streamStop) return;
+
+            chunkIndex = streamRequests.front();
+            streamRequests.pop_front();
+            streamLoading = chunkIndex;
+        }
+
+        const size_t chunkX = chunkIndex % chunkColumns;
+        const size_t chunkY = chunkIndex / chunkColumns;
+        const size_t width = chunkWidth(chunkX);
+        const size_t height = chunkHeight(chunkY);
+        std::vector<uint16_t> chunkTileIds(width * height, EMPTY_TILE); // a failed read leaves the chunk empty
+
+        for (size_t localY = 0; localY < height && fileStream; ++localY) {
+            const size_t cell = (chunkY * CHUNK_SIZE + localY) * tileMapWidth + chunkX * CHUNK_SIZE;
+            fileStream.seekg(static_cast<std::streamoff>(streamGridOffset + cell * sizeof(uint16_t)));
+            fileStream.read(reinterpret_cast<char*>(chunkTileIds.data() + localY * width), width * sizeof(uint16_t));
+        }
+        if (!fileStream) {
+            std::fill(chunkTileIds.begin(), chunkTileIds.end(), EMPTY_TILE);
+            fileStream.clear();
+        }
+        for (uint16_t& id : chunkTileIds) id = id < streamPalette.size() ? streamPalette[id] : EMPTY_TILE;
+
+        std::lock_guard<std::mutex> lock(streamMutex);
+        streamResults.emplace_back(chunkIndex, std::move(chunkTileIds));
+        streamLoading = SIZE_MAX;
+    }
+}
+
+void TileMap::makeResident(size_t chunkIndex, std::vector<uint16_t> chunkTileIds, bool edited) {
+    const size_t chunkX = chunkIndex % chunkColumns;
+    const size_t chunkY = chunkIndex / chunkColumns;
+    const size_t width = chunkWidth(chunkX);
+    const size_t height = chunkHeight(chunkY);
+
+    StreamedChunk chunk;
+    chunk.tileIds = std::move(chunkTileIds);
+    chunk.vertices = sf::VertexArray(sf::Quads, width * height * 4);
+    chunk.edited = edited;
+    for (size_t localY = 0; localY < height; ++localY) {
+        for (size_t localX = 0; localX < width; ++localX) {
+            const uint16_t tileId = chunk.tileIds[localY * width + localX];
+            writeTileQuad(&chunk.vertices[(localY * width + localX) * 4], chunkX * CHUNK_SIZE + localX, chunkY * CHUNK_SIZE + localY, tileId);
+
+            const Tile* tile = getTileType(tileId);
+            if (tile && !tile->getWalkable()) chunk.solidRows[localY] |= uint64_t(1) << localX;
+        }
+    }
+
+    residentBytes += chunkBytes(chunkIndex);
+    residentChunks[chunkIndex] = std::move(chunk);
+    if (chunkChanged) chunkChanged(chunkIndex);
+}
+
+void TileMap::evictChunk(size_t chunkIndex) {
+    auto found = residentChunks.find(chunkIndex);
+    if (found == residentChunks.end()) return;
+
+    if (found->second.edited) editedChunks[chunkIndex] = std::move(found->second.tileIds);
+    residentBytes -= chunkBytes(chunkIndex);
+    residentChunks.erase(found);
+    if (chunkChanged) chunkChanged(chunkIndex);
+}
+
+void TileMap::updateStreaming(sf::Vector2f viewCenter) {
+    if (!streaming) return;
+
+    std::vector<std::pair<size_t, std::vector<uint16_t>>>& finished = streamFinished; 
+    finished.clear(); 
+    {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        finished.swap(streamResults);
+    }
+
+    const long long centerX = static_cast<long long>(std::floor((viewCenter.x - tileMapPosition.x) / (tileWidth * CHUNK_SIZE)));
+    const long long centerY = static_cast<long long>(std::floor((viewCenter.y - tileMapPosition.y) / (tileHeight * CHUNK_SIZE)));
+    auto distance = [&](size_t chunkIndex) -> size_t { // in chunks, square rings around the center
+        const long long dx = static_cast<long long>(chunkIndex % chunkColumns) - centerX;
+        const long long dy = static_cast<long long>(chunkIndex / chunkColumns) - centerY;
+        return static_cast<size_t>(std::max(std::llabs(dx), std::llabs(dy)));
+    };
+
+    for (auto& [chunkIndex, chunkTileIds] : finished) {
+        if (!residentChunks.count(chunkIndex) && distance(chunkIndex) <= streamSettings.evictRadius) {
+            makeResident(chunkIndex, std::move(chunkTileIds), false);
+        }
+    }
+
+    // out of range first, then the farthest until the budgets hold
+    std::vector<size_t>& residentIndices = streamOrder; 
+    residentIndices.clear(); 
+    for (const auto& [chunkIndex, chunk] : residentChunks) residentIndices.push_back(chunkIndex);
+    std::sort(residentIndices.begin(), residentIndices.end(), [&](size_t a, size_t b) { return distance(a) > distance(b); });
+    for (size_t chunkIndex : residentIndices) {
+        const bool overBudget = residentChunks.size() > streamSettings.maxResidentChunks || residentBytes > streamSettings.memoryBudget;
+        if (!overBudget && distance(chunkIndex) <= streamSettings.evictRadius) break;
+        evictChunk(chunkIndex);
+    }
+
+    // everything missing in the load radius, nearest first
+    std::vector<size_t>& wanted = streamWanted; 
+    wanted.clear(); 
+    const long long radius = static_cast<long long>(streamSettings.loadRadius);
+    const long long firstX = std::max(centerX - radius, 0LL);
+    const long long firstY = std::max(centerY - radius, 0LL);
+    const long long lastX = std::min(centerX + radius, static_cast<long long>(chunkColumns) - 1);
+    const long long lastY = std::min(centerY + radius, static_cast<long long>(chunkRows) - 1);
+    for (long long chunkY = firstY; chunkY <= lastY; ++chunkY) {
+        for (long long chunkX = firstX; chunkX <= lastX; ++chunkX) {
+            const size_t chunkIndex = static_cast<size_t>(chunkY) * chunkColumns + static_cast<size_t>(chunkX);
+            if (!residentChunks.count(chunkIndex)) wanted.push_back(chunkIndex);
+        }
+    }
+    std::stable_sort(wanted.begin(), wanted.end(), [&](size_t a, size_t b) { return distance(a) < distance(b); });
+
+    // only ask for what fits; edited chunks are already in memory and skip the thread
+    std::deque<size_t>& requests = streamNextRequests; 
+    requests.clear(); 
+    size_t projectedChunks = residentChunks.size();
+    size_t projectedBytes = residentBytes;
+    for (size_t chunkIndex : wanted) {
+        const size_t bytes = chunkBytes(chunkIndex);
+        if (projectedChunks + 1 > streamSettings.maxResidentChunks || projectedBytes + bytes > streamSettings.memoryBudget) break;
+        projectedChunks++;
+        projectedBytes += bytes;
+
+        auto edited = editedChunks.find(chunkIndex);
+        if (edited != editedChunks.end()) {
+            makeResident(chunkIndex, std::move(edited->second), true);
+            editedChunks.erase(edited);
+        } else {
+            requests.push_back(chunkIndex);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        requests.erase(std::remove_if(requests.begin(), requests.end(), [this](size_t chunkIndex) { // already read or being read
+            if (chunkIndex == streamLoading) return true;
+            return std::any_of(streamResults.begin(), streamResults.end(), [chunkIndex](const auto& result) { return result.first == chunkIndex; });
+        }), requests.end());
+        streamRequests.swap(requests); // the old queue comes back to be refilled next frame
+    }
+    streamCondition.notify_one();
+}
@@ -11,29 +11,38 @@
 #include <SFML/Graphics.hpp>
 #include <fstream>
 #include <sstream>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
 #include "../../test-logging/log.hpp"
+#include "../globals/globals.hpp"
 
 
 class Tile {
 public:
     // Constructor with position, scale, texture, and a texture rect (to support tilesets)
-    explicit Tile(sf::Vector2f scale, std::weak_ptr<sf::Texture> texture, sf::IntRect textureRect, std::weak_ptr<sf::Uint8[]> bitmask, bool walkable = true); 
+    explicit Tile(sf::Vector2f scale, std::weak_ptr<sf::Texture> texture, sf::IntRect textureRect, std::weak_ptr<Bitmask> bitmask, bool walkable = true); 
     
     sf::Sprite& getTileSprite() const { return *tileSprite; } 
 
     sf::IntRect const getTextureRect() const { return textureRect; }
-    std::weak_ptr<sf::Uint8[]>  const getBitMask() const { return bitmask; }
+    std::weak_ptr<sf::Texture> const getTexture() const { return texture; }
+    sf::Vector2f const getScale() const { return scale; }
+    std::weak_ptr<Bitmask>  const getBitMask() const { return bitmask; }
  
     bool getWalkable() const { return walkable; }
     void setWalkable(bool newWalkable) { walkable = newWalkable; }
     
-    // making copies for use in tilemap
-    virtual std::unique_ptr<Tile> clone() const {
-        return std::unique_ptr<Tile>(new Tile(*this)); // Create a new instance with the same properties
-    }
     virtual ~Tile() {} 
-    Tile(const Tile& other); 
 
 private:
     sf::Vector2f position {};
@@ -41,18 +50,80 @@ private:
     sf::Vector2f scale {};
     std::weak_ptr<sf::Texture> texture;
     sf::IntRect textureRect {};   // Texture portion for this tile
-    std::weak_ptr<sf::Uint8[]> bitmask; 
+    std::weak_ptr<Bitmask> bitmask; 
     bool walkable {};
 };
 
+// a whole file mapped into memory copy-on-write, so writing through data() never touches the file on disk
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::filesystem::path& filePath); // false if the file can't be mapped (or is empty)
+    void close();
+    unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    unsigned char* bytes {};
+    size_t length {};
+};
+
+// the map itself is a grid of tile type ids into a palette of the shared tile types (rect, walkable, bitmask), so a cell is 2
+// bytes. tiles are drawn as CHUNK_SIZE x CHUNK_SIZE blocks of quads in one vertex array each, so a chunk is a single draw
+// call, and only chunks under the target's view get drawn. every tile type has to come from the same tileset texture.
+// in streaming mode only the chunks around the view are in memory; a background thread reads them out of a raw .tmap
 class TileMap : public sf::Drawable {
 public:
-    // Constructor now accepts a shared_ptr to a default tile, and initializes the map with it
-    explicit TileMap(std::shared_ptr<Tile>* tileTypesArray, unsigned int tileTypesNumber, size_t tileMapWidth, size_t tileMapHeight, float tileWidth, float tileHeight, std::filesystem::path filePath, sf::Vector2f tileMapPosition);
-    ~TileMap() = default;
+    static constexpr size_t CHUNK_SIZE = 16; // in tiles
+    static_assert(CHUNK_SIZE <= 64, "streamed chunks keep a row of solidity in one word");
+    static constexpr uint16_t EMPTY_TILE = 0xFFFF; // cells with nothing in them
+
+    // binary .tmap layout: header, then paletteSize uint16 ids mapping file ids to tile type ids, then the grid. the grid is
+    // either width * height uint16 file ids (row-major) or, with BINARY_FLAG_RLE, { run length, file id } uint16 pairs.
+    // everything is in host byte order, a file from the other endianness fails the version check and falls back to text
+    struct BinaryHeader {
+        char magic[4];
+        uint16_t version;
+        uint16_t flags;
+        uint32_t width;
+        uint32_t height;
+        uint32_t paletteSize;
+        uint32_t gridBytes;
+    };
+    static_assert(sizeof(BinaryHeader) == 24, "the .tmap header layout is fixed");
+    static constexpr char BINARY_MAGIC[4] = { 'T', 'M', 'A', 'P' };
+    static constexpr uint16_t BINARY_VERSION = 1;
+    static constexpr uint16_t BINARY_FLAG_RLE = 1;
+
+    // radii are in chunks around the chunk under the view center (square, not round). the budgets cap how many chunks are
+    // resident; when they're tighter than the load radius the nearest chunks win
+    struct StreamingSettings {
+        size_t loadRadius {};
+        size_t evictRadius {}; // raised to loadRadius if smaller
+        size_t maxResidentChunks {};
+        size_t memoryBudget {}; // bytes, ids + vertices of resident chunks
+    };
+
+    // tile types are shared with the caller and used as the palette, ids in the file index into it. a .tmap path is loaded as
+    // binary; for a text path the .tmap next to it is used as a cache (rebuilt when the text is newer), and the text is parsed
+    // directly if that fails. with streaming settings the map size comes from the .tmap header and only nearby chunks are
+    // kept; if the file can't be streamed (missing, run-length encoded) the whole map is loaded instead
+    explicit TileMap(std::shared_ptr<Tile>* tileTypesArray, unsigned int tileTypesNumber, size_t tileMapWidth, size_t tileMapHeight, float tileWidth, float tileHeight, std::filesystem::path filePath, sf::Vector2f tileMapPosition, std::optional<StreamingSettings> streamingSettings = std::nullopt);
+    ~TileMap(); 
+    TileMap(const TileMap&) = delete;
+    TileMap& operator=(const TileMap&) = delete;
     
-    // Add a tile to the map at the specified grid position (x, y)
-    void addTile(unsigned int x, unsigned int y, std::unique_ptr<Tile> tile); 
+    // Add a tile to the map at the specified grid position (x, y). when streaming, the chunk has to be resident; edits are
+    // kept in memory across evictions but never written back to the file
+    void addTile(unsigned int x, unsigned int y, uint16_t tileId); 
+    uint16_t getTileId(size_t x, size_t y) const; // EMPTY_TILE outside the map or in a chunk that isn't resident
+    const Tile* getTileType(uint16_t tileId) const { return tileId < palette.size() ? palette[tileId].get() : nullptr; }
+    const uint16_t* getTileIds() const { return tileIds; } // tileMapWidth * tileMapHeight ids, null when streaming
+    bool isMapped() const { return mappedFile.data() != nullptr; } // ids are read straight out of the mapped .tmap
     float const getTileWidth() const { return tileWidth; }
     float const getTileHeight() const { return tileHeight; }
     size_t const getTileMapWidth() const { return tileMapWidth; }
@@ -60,7 +131,78 @@ public:
     sf::Vector2f const getTileMapPosition() const { return tileMapPosition; }
     unsigned int const getTileTypesNumber() const { return tileTypesNumber; }
 
+    // cell queries against the solidity grid; a tile is solid when it isn't walkable. chunks that aren't resident are empty
+    bool isSolid(size_t x, size_t y) const; 
+    sf::IntRect getCellRange(const sf::FloatRect& bounds) const; // cells the bounds overlap, clamped to the map (empty if none)
+    bool overlapsSolid(const sf::FloatRect& bounds) const; // only looks at the cells under bounds
+    // true if any cell under bounds is in a chunk the loader hasn't brought in yet (after spawning or teleporting), so a
+    // caller can wait for it instead of reading those cells as empty. always false without streaming
+    bool overlapsUnloaded(const sf::FloatRect& bounds) const; 
+
+    size_t getChunkCount() const { return chunkColumns * chunkRows; }
+    size_t getChunkColumns() const { return chunkColumns; }
+    size_t getChunkRows() const { return chunkRows; }
+    sf::Vector2f getChunkSize() const { return { tileWidth * CHUNK_SIZE, tileHeight * CHUNK_SIZE }; } // pixels
+
+    // for caching chunks: draws one chunk (nothing if it isn't loaded), and gets told whenever a chunk's tiles change
+    // (addTile, or a streamed chunk coming in or going out)
+    void drawChunk(sf::RenderTarget& target, size_t chunkIndex, sf::RenderStates states = sf::RenderStates::Default) const; 
+    void setChunkChangedCallback(std::function<void(size_t chunkIndex)> callback) { chunkChanged = std::move(callback); }
+
+    // for drawing somewhere else (a render::FrameSnapshot): the loaded chunks under a world rect, in draw order. returns how
+    // many chunks it visited. the vertices use the tileset texture and belong to the map, copy them before it changes
+    size_t forEachVisibleChunk(const sf::FloatRect& area, const std::function<void(const sf::VertexArray& chunk)>& visit) const; 
+    const sf::Texture* getTilesetTexture() const { return tilesetTexture.lock().get(); } // owned by Constants, not the map
+
+    // streaming: call once a frame with the view center (world coordinates). takes finished loads, evicts and queues new
+    // loads without ever touching the disk itself. does nothing if the map isn't streaming
+    void updateStreaming(sf::Vector2f viewCenter); 
+    bool isStreaming() const { return streaming; }
+    size_t getResidentChunkCount() const { return streaming ? residentChunks.size() : chunks.size(); }
+    size_t getResidentBytes() const { return residentBytes; }
+
+    struct DrawStats { // from the last draw, for profiling
+        size_t drawnChunks {};
+        size_t culledChunks {};
+        size_t drawnTiles {};
+    };
+    DrawStats const getDrawStats() const { return drawStats; }
+
+    // writes the whitespace text format (also what Constants::writeRandomTileMap makes) as a .tmap with an identity palette.
+    // ids have to be below tileTypesNumber, the same as when the text is loaded directly; false (nothing written) otherwise.
+    // leave compress off for files that should load zero-copy
+    static bool convertToBinary(const std::filesystem::path& textPath, const std::filesystem::path& binaryPath, size_t tileMapWidth, size_t tileMapHeight, unsigned int tileTypesNumber, bool compress = false);
+
 private:
+    static std::vector<uint16_t> readTextGrid(const std::filesystem::path& filePath, size_t tileMapWidth, size_t tileMapHeight, unsigned int idLimit);
+    bool loadFromBinary(const std::filesystem::path& filePath);
+    static bool binaryMatches(const std::filesystem::path& filePath, size_t tileMapWidth, size_t tileMapHeight); // readable .tmap of that size
+    void loadFromText(const std::filesystem::path& filePath);
+
+    void rebuildSolidity(); 
+    void setSolid(size_t x, size_t y, bool solid); 
+    void findTilesetTexture(); 
+    void buildChunks(); 
+    void updateTileVertices(size_t x, size_t y); 
+    void writeTileQuad(sf::Vertex* quad, size_t x, size_t y, uint16_t tileId) const; // quad = 4 vertices
+
+    struct StreamedChunk {
+        std::vector<uint16_t> tileIds; // chunk width * chunk height, row-major
+        uint64_t solidRows[CHUNK_SIZE] {}; // bit x of row y
+        sf::VertexArray vertices; 
+        bool edited {}; 
+    };
+
+    bool startStreaming(const std::filesystem::path& binaryPath, const StreamingSettings& settings); 
+    void stopStreaming(); 
+    void streamLoop(); // background thread, the only place streamed chunks get read from disk
+    void makeResident(size_t chunkIndex, std::vector<uint16_t> chunkTileIds, bool edited); 
+    void evictChunk(size_t chunkIndex); 
+    size_t chunkWidth(size_t chunkX) const { return std::min(CHUNK_SIZE, tileMapWidth - chunkX * CHUNK_SIZE); }
+    size_t chunkHeight(size_t chunkY) const { return std::min(CHUNK_SIZE, tileMapHeight - chunkY * CHUNK_SIZE); }
+    size_t chunkBytes(size_t chunkIndex) const; 
+    const StreamedChunk* findResidentChunk(size_t x, size_t y) const; // chunk holding the cell, null if it isn't resident
+
     unsigned int tileTypesNumber {};
     size_t tileMapWidth{};
     size_t tileMapHeight{}; 
@@ -68,9 +210,44 @@ private:
     float tileWidth {};
     float tileHeight {};
 
-    std::vector<std::unique_ptr<Tile>> tiles; 
+    std::vector<std::shared_ptr<Tile>> palette; 
+    uint16_t* tileIds {}; // row-major, EMPTY_TILE where the file had nothing. points into ownedTileIds or mappedFile
+    std::vector<uint16_t> ownedTileIds; 
+    MappedFile mappedFile; 
     sf::Vector2f tileMapPosition; 
 
+    std::vector<uint64_t> solidCells; // 1 bit per cell, each row starts on a new word
+    size_t solidRowWords {};
+
+    std::vector<sf::VertexArray> chunks; // row-major, 4 vertices per tile
+    size_t chunkColumns {};
+    size_t chunkRows {};
+    std::weak_ptr<sf::Texture> tilesetTexture; 
+    mutable DrawStats drawStats; 
+    std::function<void(size_t chunkIndex)> chunkChanged; 
+
+    bool streaming {}; 
+    StreamingSettings streamSettings; 
+    std::unordered_map<size_t, StreamedChunk> residentChunks; // main thread only
+    std::unordered_map<size_t, std::vector<uint16_t>> editedChunks; // edits of evicted chunks, reused instead of the file
+    size_t residentBytes {}; 
+    // reused by updateStreaming() every frame instead of being made fresh, main thread only
+    std::vector<std::pair<size_t, std::vector<uint16_t>>> streamFinished; // swapped with streamResults
+    std::vector<size_t> streamOrder; // resident chunks, farthest first
+    std::vector<size_t> streamWanted; 
+    std::deque<size_t> streamNextRequests; // swapped with streamRequests
+
+    std::filesystem::path streamPath; 
+    size_t streamGridOffset {}; // bytes to the grid in the .tmap
+    std::vector<uint16_t> streamPalette; // file id -> tile type id
+    std::thread streamThread; 
+    std::mutex streamMutex; // guards everything below
+    std::condition_variable streamCondition; 
+    std::deque<size_t> streamRequests; // chunk indices, nearest first
+    std::vector<std::pair<size_t, std::vector<uint16_t>>> streamResults; // loaded but not resident yet
+    size_t streamLoading = SIZE_MAX; // chunk the thread is reading right now
+    bool streamStop {}; 
+
     // Override the draw function of sf::Drawable to draw all tiles
     virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
 };
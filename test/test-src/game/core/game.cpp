@@ -11,10 +11,15 @@ GameManager::GameManager()
     log_info("\tGame initialized");
 }
 
+GameManager::~GameManager() {
+    stopRenderThread(); 
+}
+
 // runGame calls to createAssets from scenes and loops until window is closed to run scene events 
 void GameManager::runGame() {
     try {     
         loadScenes(); 
+        if (Constants::RENDER_THREAD_ENABLED) startRenderThread(); // after loading, textures are made on this thread
 
         while (mainWindow.getWindow().isOpen()) {
             countTime();
@@ -22,20 +27,117 @@ void GameManager::runGame() {
             runScenesFlags(); 
             resetFlags();
         }
+        stopRenderThread(); 
         log_info("\tGame Ended\n"); 
             
     } catch (const std::exception& e) {
         log_error("Exception in runGame: " + std::string(e.what())); 
+        stopRenderThread(); 
         mainWindow.getWindow().close(); 
     }
 }
 
 void GameManager::runScenesFlags(){
-    if(!FlagSystem::flagEvents.gameEnd){
-        if(FlagSystem::gameScene1Flags.sceneStart && !FlagSystem::gameScene1Flags.sceneEnd) gameScene->runScene();
+    if(FlagSystem::flagEvents.gameEnd) return; 
+
+    if(!Constants::FIXED_TIMESTEP_ENABLED){
+        if(FlagSystem::gameScene1Flags.sceneStart && !FlagSystem::gameScene1Flags.sceneEnd) gameScene->simulate();
+
+        if(FlagSystem::gameSceneNextFlags.sceneStart  && !FlagSystem::gameSceneNextFlags.sceneEnd) gameSceneNext->simulate();
+
+        presentScenes(1.0f); 
+        return; 
+    }
+
+    // as many fixed steps as the frame's time covers, up to the cap
+    unsigned short steps = 0; 
+    MetaComponents::deltaTime = Constants::FIXED_TIMESTEP; 
+    while (MetaComponents::stepAccumulator >= Constants::FIXED_TIMESTEP && steps < Constants::FIXED_TIMESTEP_MAX_STEPS) {
+        MetaComponents::globalTime += Constants::FIXED_TIMESTEP; 
+
+        if(FlagSystem::gameScene1Flags.sceneStart && !FlagSystem::gameScene1Flags.sceneEnd) gameScene->simulate();
+
+        if(FlagSystem::gameSceneNextFlags.sceneStart  && !FlagSystem::gameSceneNextFlags.sceneEnd) gameSceneNext->simulate();
+
+        FlagSystem::flagEvents.mouseClicked = false; // a click counts once, in the first step after it
+        MetaComponents::stepAccumulator -= Constants::FIXED_TIMESTEP; 
+        ++steps; 
+    }
+    // behind by more than the cap allows: let the simulation fall behind real time instead of taking even longer next frame
+    if (MetaComponents::stepAccumulator >= Constants::FIXED_TIMESTEP) {
+        MetaComponents::stepAccumulator = std::fmod(MetaComponents::stepAccumulator, Constants::FIXED_TIMESTEP); 
+    }
+    MetaComponents::interpolationAlpha = MetaComponents::stepAccumulator / Constants::FIXED_TIMESTEP; 
+
+    presentScenes(MetaComponents::interpolationAlpha); 
+}
+
+void GameManager::presentScenes(float alpha){
+    const bool scene1Running = FlagSystem::gameScene1Flags.sceneStart && !FlagSystem::gameScene1Flags.sceneEnd; 
+    const bool sceneNextRunning = FlagSystem::gameSceneNextFlags.sceneStart && !FlagSystem::gameSceneNextFlags.sceneEnd; 
+
+    if (!renderThread.joinable()) {
+        if(scene1Running) gameScene->present(alpha);
+
+        if(sceneNextRunning) gameSceneNext->present(alpha);
+        return; 
+    }
+
+    // frame N+1 is copied out here while the render thread may still be drawing frame N; publish waits for it to finish.
+    // only one frame gets shown, so if both scenes run the later one wins like it does when each draws and displays
+    if (!scene1Running && !sceneNextRunning) return; 
+    render::FrameSnapshot& frame = frameExchange.back(); 
+    if(scene1Running) gameScene->record(alpha, frame);
+
+    if(sceneNextRunning) gameSceneNext->record(alpha, frame);
+
+    if (frameExchange.publish()) return; 
+
+    // only the render thread stops the exchange while it's joinable, so it failed. take the context back and draw here from
+    // now on, display() paces the loop again
+    log_error("render thread stopped drawing, presenting on the main thread"); 
+    stopRenderThread(); 
+    if(scene1Running) gameScene->present(alpha);
 
-        if(FlagSystem::gameSceneNextFlags.sceneStart  && !FlagSystem::gameSceneNextFlags.sceneEnd) gameSceneNext->runScene();
+    if(sceneNextRunning) gameSceneNext->present(alpha);
+}
+
+void GameManager::startRenderThread(){
+    if (renderThread.joinable()) return; 
+
+    frameExchange.restart(); 
+    mainWindow.getWindow().setActive(false); // a context is current on one thread at a time, the render thread takes it
+    renderThread = std::thread(&GameManager::renderLoop, this); 
+    log_info("render thread started"); 
+}
+
+void GameManager::stopRenderThread(){
+    if (!renderThread.joinable()) return; 
+
+    frameExchange.stop(); 
+    renderThread.join(); 
+    mainWindow.getWindow().setActive(true); // back to this thread, for closing the window or drawing without the render thread
+    log_info("render thread stopped"); 
+}
+
+// the only place the window gets drawn to while the render thread runs. the view comes from the snapshot since the main
+// thread never sets the window's view then
+void GameManager::renderLoop(){
+    sf::RenderWindow& window = mainWindow.getWindow(); 
+    try {
+        window.setActive(true); 
+        while (const render::FrameSnapshot* frame = frameExchange.acquire()) {
+            window.setView(frame->getView()); 
+            window.clear(frame->getClearColor()); 
+            window.draw(*frame); 
+            window.display(); // the frame limit sleeps here, which paces the simulation through publish
+            frameExchange.release(); 
+        }
+    } catch (const std::exception& e) {
+        log_error("Exception in renderLoop: " + std::string(e.what())); 
+        frameExchange.stop(); // the simulation would wait on publish forever otherwise
     }
+    window.setActive(false); 
 }
 
 void GameManager::loadScenes(){
@@ -44,10 +146,17 @@ void GameManager::loadScenes(){
     gameSceneNext->createAssets(); 
 }
 
-// countTime counts global time and delta time for scenes to later use in runScene 
+// countTime counts global time and delta time for scenes to later use in runScene. with a fixed step the frame's time goes
+// into the step accumulator instead, and runScenesFlags advances the clocks one step at a time
 void GameManager::countTime() {
     sf::Time frameTime = MetaComponents::clock.restart();
-    MetaComponents::deltaTime = frameTime.asSeconds(); 
+    MetaComponents::frameTime = frameTime.asSeconds(); 
+
+    if (Constants::FIXED_TIMESTEP_ENABLED) {
+        MetaComponents::stepAccumulator += MetaComponents::frameTime; 
+        return; 
+    }
+    MetaComponents::deltaTime = MetaComponents::frameTime; 
     MetaComponents::globalTime += MetaComponents::deltaTime;
 }
 
@@ -59,6 +168,7 @@ void GameManager::handleEventInput() {
         if (event.type == sf::Event::Closed) {
             log_info("Window close event detected.");
             FlagSystem::flagEvents.gameEnd = true;
+            stopRenderThread(); 
             mainWindow.getWindow().close();
             return; 
         }
@@ -104,6 +214,6 @@ void GameManager::handleEventInput() {
 }
 
 void GameManager::resetFlags(){
-    FlagSystem::flagEvents.mouseClicked = false;
+    if (!Constants::FIXED_TIMESTEP_ENABLED) FlagSystem::flagEvents.mouseClicked = false; // otherwise the first step clears it, frames without a step keep it
 }
 
@@ -9,6 +9,8 @@
 
 #include <iostream>
 #include <stdexcept>
+#include <cmath>
+#include <thread>
 
 #include <SFML/Graphics.hpp>
 
@@ -17,6 +19,7 @@
 class GameManager {
 public:
     GameManager();
+    ~GameManager(); 
     void loadScenes(); 
     void runGame();
     void runScenesFlags();
@@ -25,8 +28,17 @@ public:
 private:
     void countTime(); // countTime counts time regardless of the scene 
     void handleEventInput(); // handleEventInput taks input from device, such as keyboard, mouse, etc */
+    void presentScenes(float alpha); // draws the running scenes, or hands them to the render thread
+
+    // with the render thread on, the main thread polls events and simulates while the render thread owns the GL context and
+    // draws the last published frame
+    void startRenderThread(); 
+    void stopRenderThread(); // before closing the window; does nothing if it isn't running
+    void renderLoop(); 
 
     GameWindow mainWindow;
+    render::FrameExchange frameExchange; 
+    std::thread renderThread; 
 
     std::unique_ptr<introScene> introScreenScene; 
     std::unique_ptr<gamePlayScene> gameScene;
@@ -4,6 +4,7 @@
 //
 
 #include "globals.hpp"  
+#include "../render/render.hpp"
 
 namespace MetaComponents {
     sf::Clock clock;
@@ -51,6 +52,44 @@ namespace SpriteComponents {
     }
 }
 
+namespace PhysicsComponents {
+    BroadphaseType toBroadphaseType(const std::string& broadphase) {
+        static const std::unordered_map<std::string, BroadphaseType> broadphaseMap = {
+            {"QUADTREE", BroadphaseType::QUADTREE},
+            {"GRID", BroadphaseType::GRID},
+            {"SWEEP_AND_PRUNE", BroadphaseType::SWEEP_AND_PRUNE}
+        };
+
+        auto it = broadphaseMap.find(broadphase);
+        return (it != broadphaseMap.end()) ? it->second : BroadphaseType::QUADTREE; // Default to quadtree if not found
+    }
+}
+
+void Bitmask::buildCoarseLevels() {
+    unsigned int left = width, top = height, right = 0, bottom = 0;
+    for (unsigned int y = 0; y < height; ++y) {
+        for (unsigned int x = 0; x < width; ++x) {
+            if (!test(x, y)) continue;
+            left = std::min(left, x);
+            top = std::min(top, y);
+            right = std::max(right, x + 1);
+            bottom = std::max(bottom, y + 1);
+        }
+    }
+    opaqueBounds = (right > left) ? sf::IntRect(left, top, right - left, bottom - top) : sf::IntRect{};
+
+    coarseLevels.clear();
+    for (unsigned int blockSize : COARSE_BLOCK_SIZES) {
+        Bitmask level((width + blockSize - 1) / blockSize, (height + blockSize - 1) / blockSize);
+        for (unsigned int y = top; y < bottom; ++y) {
+            for (unsigned int x = left; x < right; ++x) {
+                if (test(x, y)) level.set(x / blockSize, y / blockSize);
+            }
+        }
+        coarseLevels.push_back(std::move(level));
+    }
+}
+
 /* constant variables defined here */
 namespace Constants {
     // make random position from upper right corner
@@ -66,6 +105,7 @@ namespace Constants {
         readFromYaml(std::filesystem::path("test/test-src/game/globals/config.yaml"));
         loadAssets();
         makeRectsAndBitmasks(); 
+        buildTextureAtlases(); // after the bitmasks, they're relative to each rect so they don't move
     }
 
     void readFromYaml(const std::filesystem::path configFile) {
@@ -77,6 +117,9 @@ namespace Constants {
             WORLD_WIDTH = config["world"]["width"].as<unsigned short>();
             WORLD_HEIGHT = config["world"]["height"].as<unsigned short>();
             FRAME_LIMIT = config["world"]["frame_limit"].as<unsigned short>();
+            FIXED_TIMESTEP_ENABLED = config["world"]["fixed_timestep"]["enabled"].as<bool>();
+            FIXED_TIMESTEP = std::max(config["world"]["fixed_timestep"]["step"].as<float>(), 0.001f);
+            FIXED_TIMESTEP_MAX_STEPS = std::max<unsigned short>(config["world"]["fixed_timestep"]["max_steps"].as<unsigned short>(), 1);
             GAME_TITLE = config["world"]["title"].as<std::string>();
             VIEW_SIZE_X = config["world"]["view"]["size_x"].as<float>();
             VIEW_SIZE_Y = config["world"]["view"]["size_y"].as<float>();
@@ -105,6 +148,11 @@ namespace Constants {
             BACKGROUND_SCALE = {config["background"]["scale"]["x"].as<float>(),
                                 config["background"]["scale"]["y"].as<float>()};
             BACKGROUND_MOVING_DIRECTION = SpriteComponents::toDirection(config["background"]["moving_direction"].as<std::string>());
+            for (const auto& layer : config["background"]["layers"]) {
+                BACKGROUND_LAYER_PATHS.emplace_back(layer["path"].as<std::string>());
+                BACKGROUND_LAYER_SPEED_FACTORS.push_back(layer["speed_factor"].as<float>());
+                BACKGROUND_LAYER_SCALES.emplace_back(layer["scale"]["x"].as<float>(), layer["scale"]["y"].as<float>());
+            }
 
             // Load sprite paths and settings
             SPRITE1_PATH = config["sprites"]["sprite1"]["path"].as<std::string>();
@@ -115,6 +163,7 @@ namespace Constants {
                                 config["sprites"]["sprite1"]["jump_acceleration"]["y"].as<float>()};           
             SPRITE1_INDEXMAX = config["sprites"]["sprite1"]["index_max"].as<short>();
             SPRITE1_ANIMATIONROWS = config["sprites"]["sprite1"]["animation_rows"].as<short>();
+            SPRITE1_FRAME_TIME = config["sprites"]["sprite1"]["frame_time"].as<float>();
             SPRITE1_POSITION = {config["sprites"]["sprite1"]["position"]["x"].as<float>(),
                                 config["sprites"]["sprite1"]["position"]["y"].as<float>()};
             SPRITE1_SCALE = {config["sprites"]["sprite1"]["scale"]["x"].as<float>(),
@@ -122,12 +171,24 @@ namespace Constants {
 
             // Load button settings
             BUTTON1_INDEXMAX = config["sprites"]["button1"]["index_max"].as<short>();
+            BUTTON1_FRAME_TIME = config["sprites"]["button1"]["frame_time"].as<float>();
             BUTTON1_PATH = config["sprites"]["button1"]["path"].as<std::string>();
             BUTTON1_POSITION = {config["sprites"]["button1"]["position"]["x"].as<float>(),
                                 config["sprites"]["button1"]["position"]["y"].as<float>()};
             BUTTON1_SCALE = {config["sprites"]["button1"]["scale"]["x"].as<float>(),
                             config["sprites"]["button1"]["scale"]["y"].as<float>()};
 
+            // Load bullet settings
+            BULLET1_INDEXMAX = config["sprites"]["bullet1"]["index_max"].as<short>();
+            BULLET1_FRAME_TIME = config["sprites"]["bullet1"]["frame_time"].as<float>();
+            BULLET1_PATH = config["sprites"]["bullet1"]["path"].as<std::string>();
+            BULLET1_SCALE = {config["sprites"]["bullet1"]["scale"]["x"].as<float>(),
+                            config["sprites"]["bullet1"]["scale"]["y"].as<float>()};
+            BULLET1_SPEED = config["sprites"]["bullet1"]["speed"].as<float>();
+            BULLET1_ACCELERATION = {config["sprites"]["bullet1"]["acceleration"]["x"].as<float>(),
+                                config["sprites"]["bullet1"]["acceleration"]["y"].as<float>()};
+            BULLET1_POOL_CAPACITY = config["sprites"]["bullet1"]["pool_capacity"].as<size_t>();
+
             // Load tile settings
             TILES_PATH = config["tiles"]["path"].as<std::string>();
             TILES_ROWS = config["tiles"]["rows"].as<unsigned short>();
@@ -148,6 +209,12 @@ namespace Constants {
                 }
             }
 
+            // Load texture atlas settings
+            ATLAS_ENABLED = config["atlas"]["enabled"].as<bool>();
+            ATLAS_MAX_SIZE = config["atlas"]["max_size"].as<unsigned int>();
+            ATLAS_PADDING = config["atlas"]["padding"].as<unsigned int>();
+            ATLAS_TEXTURES = config["atlas"]["textures"].as<std::vector<std::string>>();
+
             // Load tilemap settings
             TILEMAP_POSITION = {config["tilemap"]["position"]["x"].as<float>(),
                                 config["tilemap"]["position"]["y"].as<float>()};
@@ -155,6 +222,22 @@ namespace Constants {
             TILEMAP_HEIGHT = config["tilemap"]["height"].as<size_t>();
             TILEMAP_BOUNDARYOFFSET = config["tilemap"]["boundary_offset"].as<float>();
             TILEMAP_FILEPATH = config["tilemap"]["filepath"].as<std::string>();
+            TILEMAP_STREAMING = config["tilemap"]["streaming"]["enabled"].as<bool>();
+            TILEMAP_STREAM_LOAD_RADIUS = config["tilemap"]["streaming"]["load_radius"].as<size_t>();
+            TILEMAP_STREAM_EVICT_RADIUS = config["tilemap"]["streaming"]["evict_radius"].as<size_t>();
+            TILEMAP_STREAM_MAX_CHUNKS = config["tilemap"]["streaming"]["max_resident_chunks"].as<size_t>();
+            TILEMAP_STREAM_MEMORY_BUDGET = config["tilemap"]["streaming"]["memory_budget_kb"].as<size_t>() * 1024;
+
+            // Load broadphase settings
+            QUADTREE_MAX_OBJECTS = config["broadphase"]["quadtree"]["max_objects"].as<size_t>();
+            QUADTREE_MAX_LEVELS = config["broadphase"]["quadtree"]["max_levels"].as<size_t>();
+            GAMESCENE1_BROADPHASE = PhysicsComponents::toBroadphaseType(config["broadphase"]["scenes"]["game_scene1"].as<std::string>());
+            GAMESCENE2_BROADPHASE = PhysicsComponents::toBroadphaseType(config["broadphase"]["scenes"]["game_scene2"].as<std::string>());
+
+            // Load render settings
+            STATIC_CACHE_ENABLED = config["render"]["static_cache"]["enabled"].as<bool>();
+            STATIC_CACHE_MAX_TEXTURES = config["render"]["static_cache"]["max_textures"].as<size_t>();
+            RENDER_THREAD_ENABLED = config["render"]["render_thread"]["enabled"].as<bool>();
 
             // Load text settings
             TEXT_SIZE = config["text"]["size"].as<unsigned short>();
@@ -187,11 +270,22 @@ namespace Constants {
         if (!BACKGROUND_TEXTURE->loadFromFile(BACKGROUNDSPRITE_PATH)) log_warning("Failed to load background texture");
 
         if (!BACKGROUND_TEXTURE2->loadFromFile(BACKGROUNDSPRITE_PATH2)) log_warning("Failed to load background2 texture");
+
+        for (const auto& path : BACKGROUND_LAYER_PATHS) { // layers can reuse the day/night textures
+            if (path == BACKGROUNDSPRITE_PATH) BACKGROUND_LAYER_TEXTURES.push_back(BACKGROUND_TEXTURE);
+            else if (path == BACKGROUNDSPRITE_PATH2) BACKGROUND_LAYER_TEXTURES.push_back(BACKGROUND_TEXTURE2);
+            else {
+                BACKGROUND_LAYER_TEXTURES.push_back(std::make_shared<sf::Texture>());
+                if (!BACKGROUND_LAYER_TEXTURES.back()->loadFromFile(path)) log_warning("Failed to load background layer texture: " + path.string());
+            }
+        }
         
         if (!BUTTON1_TEXTURE->loadFromFile(BUTTON1_PATH)) log_warning("Failed to load button texture");
 
         if (!SPRITE1_TEXTURE->loadFromFile(SPRITE1_PATH)) log_warning("Failed to load sprite1 texture");
 
+        if (!BULLET1_TEXTURE->loadFromFile(BULLET1_PATH)) log_warning("Failed to load bullet1 texture");
+
         if (!TILES_TEXTURE->loadFromFile(TILES_PATH)) log_warning("Failed to load tiles texture");
 
         if (!BACKGROUNDMUSIC_MUSIC->openFromFile(BACKGROUNDMUSIC_PATH)) log_warning("Failed to load background music");
@@ -221,6 +315,19 @@ namespace Constants {
         for (const auto& rect : BUTTON1_ANIMATIONRECTS ) {
             BUTTON1_BITMASK.emplace_back(createBitmask(BUTTON1_TEXTURE, rect));
         }
+        BUTTON1_BITMASK_UNION = createUnionBitmask(BUTTON1_BITMASK); 
+
+        // bullet frames are square, side by side in one row
+        const int bulletFrameWidth = BULLET1_INDEXMAX > 0 ? static_cast<int>(BULLET1_TEXTURE->getSize().x) / BULLET1_INDEXMAX : 0; 
+        BULLET1_ANIMATIONRECTS.reserve(BULLET1_INDEXMAX); 
+        for(int i = 0; i < BULLET1_INDEXMAX; ++i ){
+            BULLET1_ANIMATIONRECTS.emplace_back(sf::IntRect{ bulletFrameWidth * i, 0, bulletFrameWidth, static_cast<int>(BULLET1_TEXTURE->getSize().y) }); 
+        }
+        BULLET1_BITMASK.reserve(BULLET1_INDEXMAX); 
+        for (const auto& rect : BULLET1_ANIMATIONRECTS ) {
+            BULLET1_BITMASK.emplace_back(createBitmask(BULLET1_TEXTURE, rect));
+        }
+        BULLET1_BITMASK_UNION = createUnionBitmask(BULLET1_BITMASK); 
 
         TILES_SINGLE_RECTS.reserve(TILES_NUMBER); 
         // Populate individual tile rectangles
@@ -241,10 +348,69 @@ namespace Constants {
         for (const auto& rect : SPRITE1_ANIMATIONRECTS ) {
             SPRITE1_BITMASK.emplace_back(createBitmask(SPRITE1_TEXTURE, rect));
         }
+        SPRITE1_BITMASK_UNION = createUnionBitmask(SPRITE1_BITMASK); 
         
         log_info("\tConstants initialized ");
     }
 
+    void buildTextureAtlases() {
+        if (!ATLAS_ENABLED) return;
+
+        try {
+            struct AtlasSource {
+                std::shared_ptr<sf::Texture>* texture;
+                std::vector<sf::IntRect>* rects;
+            };
+            const std::unordered_map<std::string, AtlasSource> atlasSources = {
+                { "sprite1", { &SPRITE1_TEXTURE, &SPRITE1_ANIMATIONRECTS } },
+                { "button1", { &BUTTON1_TEXTURE, &BUTTON1_ANIMATIONRECTS } },
+                { "bullet1", { &BULLET1_TEXTURE, &BULLET1_ANIMATIONRECTS } },
+                { "tiles", { &TILES_TEXTURE, &TILES_SINGLE_RECTS } },
+            };
+
+            std::vector<AtlasSource> sources;
+            std::vector<sf::Image> images;
+            for (const auto& name : ATLAS_TEXTURES) {
+                auto source = atlasSources.find(name);
+                if (source == atlasSources.end()) {
+                    log_warning("\tcan't put " + name + " in an atlas ( not a packable texture )");
+                    continue;
+                }
+                const auto& texture = *source->second.texture;
+                if (!texture || !texture->getSize().x || !texture->getSize().y) {
+                    log_warning("\tcan't put " + name + " in an atlas ( texture isn't loaded )");
+                    continue;
+                }
+                if (std::any_of(sources.begin(), sources.end(), [&](const AtlasSource& added) { return added.texture == source->second.texture; })) continue;
+
+                sources.push_back(source->second);
+                images.push_back(texture->copyToImage());
+            }
+            if (sources.empty()) return;
+
+            std::vector<render::AtlasPlacement> placements;
+            ATLAS_PAGES = render::buildAtlases(images, ATLAS_MAX_SIZE, ATLAS_PADDING, placements);
+
+            size_t packedCount = 0;
+            for (size_t index = 0; index < sources.size(); ++index) {
+                if (!placements[index].packed) {
+                    log_warning("\ttexture too big for an atlas page, left on its own");
+                    continue;
+                }
+                *sources[index].texture = ATLAS_PAGES[placements[index].page];
+                for (auto& rect : *sources[index].rects) {
+                    rect.left += placements[index].offset.x;
+                    rect.top += placements[index].offset.y;
+                }
+                ++packedCount;
+            }
+            log_info("\tpacked " + std::to_string(packedCount) + " textures into " + std::to_string(ATLAS_PAGES.size()) + " atlas pages");
+        }
+        catch (const std::exception& e) {
+            log_warning("Error in building texture atlases: " + std::string(e.what()));
+        }
+    }
+
     void writeRandomTileMap(const std::filesystem::path filePath) {
         try{
             std::ofstream fileStream(filePath);
@@ -274,7 +440,7 @@ namespace Constants {
         }
     }
 
-    std::shared_ptr<sf::Uint8[]> createBitmask( const std::shared_ptr<sf::Texture>& texture, const sf::IntRect& rect, const float transparency) {
+    std::shared_ptr<Bitmask> createBitmask( const std::shared_ptr<sf::Texture>& texture, const sf::IntRect& rect, const float transparency) {
         if (!texture) {
             log_warning("\tfailed to create bitmask ( texture is empty )");
             return nullptr;
@@ -293,39 +459,54 @@ namespace Constants {
         unsigned int width = rect.width;
         unsigned int height = rect.height;
 
-        unsigned int bitmaskSize = (width * height) / 8 + ((width * height) % 8 != 0); // rounding up
-        std::shared_ptr<sf::Uint8[]> bitmask(new sf::Uint8[bitmaskSize](), std::default_delete<sf::Uint8[]>());
+        auto bitmask = std::make_shared<Bitmask>(width, height);
 
         for (unsigned int y = 0; y < height; ++y) {
             for (unsigned int x = 0; x < width; ++x) {
                 sf::Color pixelColor = image.getPixel(rect.left + x, rect.top + y);
-                unsigned int bitIndex = y * width + x;
-                unsigned int byteIndex = bitIndex / 8;
-                unsigned int bitPosition = bitIndex % 8;
 
                 // Use transparency threshold if provided, otherwise default to alpha > 128
                 if ((transparency > 0.0f && pixelColor.a >= static_cast<sf::Uint8>(transparency * 255)) || 
                     (transparency <= 0.0f && pixelColor.a > 128)) {
-                    bitmask[byteIndex] |= (1 << bitPosition);
+                    bitmask->set(x, y);
                 }
             }
         }
+        bitmask->buildCoarseLevels(); 
 
         return bitmask;
     }
 
-    void printBitmaskDebug(const std::shared_ptr<sf::Uint8[]>& bitmask, unsigned int width, unsigned int height) {
-        unsigned int bitmaskSize = (width * height + 7) / 8;
+    std::shared_ptr<Bitmask> createUnionBitmask(const std::vector<std::shared_ptr<Bitmask>>& frames) {
+        unsigned int width = 0, height = 0;
+        for (const auto& frame : frames) {
+            if (!frame) continue;
+            width = std::max(width, frame->width);
+            height = std::max(height, frame->height);
+        }
+
+        auto unionMask = std::make_shared<Bitmask>(width, height);
+        for (const auto& frame : frames) {
+            if (!frame) continue;
+            for (unsigned int y = 0; y < frame->height; ++y) {
+                uint64_t* row = unionMask->words.data() + static_cast<size_t>(y) * unionMask->wordsPerRow;
+                for (unsigned int word = 0; word < frame->wordsPerRow; ++word) row[word] |= frame->row(y)[word];
+            }
+        }
+        unionMask->buildCoarseLevels(); 
+        return unionMask;
+    }
+
+    void printBitmaskDebug(const std::shared_ptr<Bitmask>& bitmask) {
+        if (!bitmask) return;
         
         std::stringstream bitmaskStream; // Use a stringstream to accumulate the bitmask output
 
-        for (unsigned int i = 0; i < bitmaskSize; ++i) {
-            for (int bit = 7; bit >= 0; --bit) { // Print bits from high to low
-                bitmaskStream << ((bitmask[i] & (1 << bit)) ? '1' : '0');
-            }
-            if ((i + 1) % (width / 8) == 0) { // New line after each row
-                bitmaskStream << std::endl;
+        for (unsigned int y = 0; y < bitmask->height; ++y) {
+            for (unsigned int x = 0; x < bitmask->width; ++x) { // Print pixels from left to right
+                bitmaskStream << (bitmask->test(x, y) ? '1' : '0');
             }
+            bitmaskStream << std::endl; // New line after each row
         }
         
         // Log the accumulated bitmask
@@ -13,6 +13,7 @@
 #include <fstream> 
 #include <yaml-cpp/yaml.h>
 #include <filesystem>
+#include <cstdint>
 
 #include "../test-logging/log.hpp"
 
@@ -23,12 +24,46 @@ namespace SpriteComponents {
     sf::Color toSfColor(const std::string& color); // convert string from yaml to sf::Color
 }
 
+namespace PhysicsComponents {
+    enum BroadphaseType { QUADTREE, GRID, SWEEP_AND_PRUNE };
+
+    BroadphaseType toBroadphaseType(const std::string& broadphase); // convert string from yaml to BroadphaseType
+}
+
+// 1 bit per pixel collision mask, bit (x % 64) of word (x / 64) in a row is pixel x. every row starts on a new 64 bit word and
+// ends with a zero padding word, so a row can be read a whole word at a time from any bit offset without going out of bounds
+struct Bitmask {
+    unsigned int width {};
+    unsigned int height {};
+    unsigned int wordsPerRow {}; // including the padding word
+    std::vector<uint64_t> words;
+
+    // filled by buildCoarseLevels(); coarse level i has a bit per COARSE_BLOCK_SIZES[i] square block, set if any pixel in it is
+    static constexpr unsigned int COARSE_BLOCK_SIZES[] = { 8, 32 };
+    sf::IntRect opaqueBounds; // tight box around the set pixels, empty for a blank mask
+    std::vector<Bitmask> coarseLevels;
+
+    Bitmask() = default;
+    Bitmask(unsigned int width, unsigned int height)
+        : width(width), height(height), wordsPerRow((width + 63) / 64 + 1), words(static_cast<size_t>(wordsPerRow) * height, 0) {}
+
+    const uint64_t* row(unsigned int y) const { return words.data() + static_cast<size_t>(y) * wordsPerRow; }
+    bool test(unsigned int x, unsigned int y) const { return (row(y)[x >> 6] >> (x & 63)) & 1u; }
+    void set(unsigned int x, unsigned int y) { words[static_cast<size_t>(y) * wordsPerRow + (x >> 6)] |= uint64_t(1) << (x & 63); }
+
+    void buildCoarseLevels(); // call once the full resolution bits are final
+    bool hasCoarseLevels() const { return !coarseLevels.empty(); }
+};
+
 namespace MetaComponents{
     inline sf::Vector2i mouseClickedPosition_i {}; 
     inline sf::Vector2f mouseClickedPosition_f {}; 
 
     inline float globalTime {};
-    inline float deltaTime {}; 
+    inline float deltaTime {}; // length of the simulation step being run, the fixed step when that's on
+    inline float frameTime {}; // real time since the last frame
+    inline float stepAccumulator {}; // real time not simulated yet
+    inline float interpolationAlpha = 1.0f; // where drawing is between the last two steps, 0 previous .. 1 current
     inline float spacePressedElapsedTime{};
 
     extern sf::Clock clock;
@@ -45,17 +80,22 @@ namespace Constants { // not actually "constants" in terms of being fixed, but s
     extern void writeRandomTileMap(const std::filesystem::path filePath); 
 
     // load textures, fonts, music, and sound
-    extern std::shared_ptr<sf::Uint8[]> createBitmask( const std::shared_ptr<sf::Texture>& texture, const sf::IntRect& rect, const float transparency = 0.0f);
-    extern void printBitmaskDebug(const std::shared_ptr<sf::Uint8[]>& bitmask, unsigned int width, unsigned int height);
+    extern std::shared_ptr<Bitmask> createBitmask( const std::shared_ptr<sf::Texture>& texture, const sf::IntRect& rect, const float transparency = 0.0f);
+    extern std::shared_ptr<Bitmask> createUnionBitmask(const std::vector<std::shared_ptr<Bitmask>>& frames); // every frame ORed together
+    extern void printBitmaskDebug(const std::shared_ptr<Bitmask>& bitmask);
     extern void loadAssets(); 
     extern void readFromYaml(const std::filesystem::path configFile); 
     extern void makeRectsAndBitmasks(); 
+    extern void buildTextureAtlases(); // packs the ATLAS_TEXTURES sheets together and moves their rects into the atlas
 
     // Game display settings
     inline float WORLD_SCALE;
     inline unsigned short WORLD_WIDTH;
     inline unsigned short WORLD_HEIGHT;
     inline unsigned short FRAME_LIMIT;
+    inline bool FIXED_TIMESTEP_ENABLED;
+    inline float FIXED_TIMESTEP;
+    inline unsigned short FIXED_TIMESTEP_MAX_STEPS;
     inline std::string GAME_TITLE;
     inline sf::Vector2f VIEW_INITIAL_CENTER;
     inline float VIEW_SIZE_X;
@@ -83,10 +123,15 @@ namespace Constants { // not actually "constants" in terms of being fixed, but s
     inline SpriteComponents::Direction BACKGROUND_MOVING_DIRECTION;
     inline std::shared_ptr<sf::Texture> BACKGROUND_TEXTURE = std::make_shared<sf::Texture>();
     inline std::shared_ptr<sf::Texture> BACKGROUND_TEXTURE2 = std::make_shared<sf::Texture>();
+    inline std::vector<std::filesystem::path> BACKGROUND_LAYER_PATHS; // parallax layers, same index across these
+    inline std::vector<float> BACKGROUND_LAYER_SPEED_FACTORS;
+    inline std::vector<sf::Vector2f> BACKGROUND_LAYER_SCALES;
+    inline std::vector<std::shared_ptr<sf::Texture>> BACKGROUND_LAYER_TEXTURES;
   
     // Sprite paths and settings
     inline short SPRITE1_INDEXMAX;
     inline short SPRITE1_ANIMATIONROWS;  
+    inline float SPRITE1_FRAME_TIME;
     inline std::filesystem::path SPRITE1_PATH;
     inline sf::Vector2f SPRITE1_POSITION;
     inline sf::Vector2f SPRITE1_SCALE;
@@ -95,16 +140,32 @@ namespace Constants { // not actually "constants" in terms of being fixed, but s
     inline sf::Vector2f SPRITE1_ACCELERATION;
     inline std::shared_ptr<sf::Texture> SPRITE1_TEXTURE = std::make_shared<sf::Texture>();
     inline std::vector<sf::IntRect> SPRITE1_ANIMATIONRECTS;
-    inline std::vector<std::shared_ptr<sf::Uint8[]>> SPRITE1_BITMASK;
+    inline std::vector<std::shared_ptr<Bitmask>> SPRITE1_BITMASK;
+    inline std::shared_ptr<Bitmask> SPRITE1_BITMASK_UNION;
 
     // Button settings
     inline short BUTTON1_INDEXMAX;
+    inline float BUTTON1_FRAME_TIME;
     inline std::filesystem::path BUTTON1_PATH;
     inline sf::Vector2f BUTTON1_POSITION;
     inline sf::Vector2f BUTTON1_SCALE;
     inline std::shared_ptr<sf::Texture> BUTTON1_TEXTURE = std::make_shared<sf::Texture>();
     inline std::vector<sf::IntRect> BUTTON1_ANIMATIONRECTS;
-    inline std::vector<std::shared_ptr<sf::Uint8[]>> BUTTON1_BITMASK;
+    inline std::vector<std::shared_ptr<Bitmask>> BUTTON1_BITMASK;
+    inline std::shared_ptr<Bitmask> BUTTON1_BITMASK_UNION;
+
+    // Bullet settings
+    inline short BULLET1_INDEXMAX;
+    inline float BULLET1_FRAME_TIME;
+    inline std::filesystem::path BULLET1_PATH;
+    inline sf::Vector2f BULLET1_SCALE;
+    inline float BULLET1_SPEED;
+    inline sf::Vector2f BULLET1_ACCELERATION;
+    inline size_t BULLET1_POOL_CAPACITY;
+    inline std::shared_ptr<sf::Texture> BULLET1_TEXTURE = std::make_shared<sf::Texture>();
+    inline std::vector<sf::IntRect> BULLET1_ANIMATIONRECTS;
+    inline std::vector<std::shared_ptr<Bitmask>> BULLET1_BITMASK;
+    inline std::shared_ptr<Bitmask> BULLET1_BITMASK_UNION;
 
     // Tile settings
     inline sf::Vector2f TILEMAP_POSITION; 
@@ -120,13 +181,36 @@ namespace Constants { // not actually "constants" in terms of being fixed, but s
     inline unsigned short TILE_HEIGHT;
     inline std::shared_ptr<sf::Texture> TILES_TEXTURE = std::make_shared<sf::Texture>();
     inline std::vector<sf::IntRect> TILES_SINGLE_RECTS;
-    inline std::vector<std::shared_ptr<sf::Uint8[]>> TILES_BITMASKS;
+    inline std::vector<std::shared_ptr<Bitmask>> TILES_BITMASKS;
+
+    // Texture atlas settings
+    inline bool ATLAS_ENABLED;
+    inline unsigned int ATLAS_MAX_SIZE;
+    inline unsigned int ATLAS_PADDING;
+    inline std::vector<std::string> ATLAS_TEXTURES;
+    inline std::vector<std::shared_ptr<sf::Texture>> ATLAS_PAGES;
 
     // Tilemap settings
     inline size_t TILEMAP_WIDTH;
     inline size_t TILEMAP_HEIGHT;
     inline float TILEMAP_BOUNDARYOFFSET; 
     inline std::filesystem::path TILEMAP_FILEPATH;
+    inline bool TILEMAP_STREAMING;
+    inline size_t TILEMAP_STREAM_LOAD_RADIUS;
+    inline size_t TILEMAP_STREAM_EVICT_RADIUS;
+    inline size_t TILEMAP_STREAM_MAX_CHUNKS;
+    inline size_t TILEMAP_STREAM_MEMORY_BUDGET; // bytes
+
+    // Broadphase settings
+    inline size_t QUADTREE_MAX_OBJECTS;
+    inline size_t QUADTREE_MAX_LEVELS;
+    inline PhysicsComponents::BroadphaseType GAMESCENE1_BROADPHASE;
+    inline PhysicsComponents::BroadphaseType GAMESCENE2_BROADPHASE;
+
+    // Render settings
+    inline bool STATIC_CACHE_ENABLED;
+    inline size_t STATIC_CACHE_MAX_TEXTURES;
+    inline bool RENDER_THREAD_ENABLED;
 
     // Text settings
     inline unsigned short TEXT_SIZE;
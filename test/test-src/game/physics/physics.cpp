@@ -1,128 +1,531 @@
 #include "physics.hpp"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // physics namespace to have sprites move 
 namespace physics {
-    Quadtree::Quadtree(float x, float y, float width, float height, size_t level, size_t maxObjects, size_t maxLevels)
-        : maxObjects(maxObjects), maxLevels(maxLevels), level(level), bounds(x, y, width, height) {}
+    Quadtree::Quadtree(float x, float y, float width, float height, size_t maxObjects, size_t maxLevels)
+        : maxObjects(maxObjects), maxLevels(maxLevels) {
+        nodes.push_back(Node{ sf::FloatRect(x, y, width, height) });
+    }
 
     void Quadtree::clear() {
-        objects.clear();
-        log_info("objects cleared.");
-        nodes.clear();
+        nodes.erase(nodes.begin() + 1, nodes.end());
+        nodes[0].objects.clear();
+        nodes[0].firstChild = -1;
+        freeBlocks.clear();
+        objectNodes.clear();
         log_info("Quadtree cleared.");
     }
 
+    void Quadtree::insert(Sprite* obj) {
+        if (!obj) return;
+        auto it = objectNodes.find(obj);
+        if (it != objectNodes.end() && it->second >= 0) { // already tracked, treat as a move
+            detach(obj, it->second);
+        }
+        insertInto(0, obj, obj->returnSpritesShape().getGlobalBounds());
+    }
+
+    void Quadtree::remove(Sprite* obj) {
+        auto it = objectNodes.find(obj);
+        if (it == objectNodes.end()) return;
+
+        int index = it->second;
+        objectNodes.erase(it);
+        if (index < 0) return; // disabled, not in any node
+        detach(obj, index);
+        tryMerge(nodes[index].parent);
+    }
+
+    void Quadtree::setEnabled(Sprite* obj, bool enabled) {
+        auto it = objectNodes.find(obj);
+        if (it == objectNodes.end() || (it->second >= 0) == enabled) return;
+
+        if (enabled) {
+            insertInto(0, obj, obj->returnSpritesShape().getGlobalBounds());
+            return;
+        }
+        int index = it->second;
+        detach(obj, index);
+        it->second = -1; // the entry stays, so enabling again doesn't allocate
+        tryMerge(nodes[index].parent);
+    }
+
     std::vector<Sprite*> Quadtree::query(const sf::FloatRect& area) const {
-        try {
-            std::vector<Sprite*> result;
-            if (!bounds.intersects(area)) {
-                log_info("Area does not intersect with the quadtree bounds at level " + std::to_string(level));
-                return result;
+        std::vector<Sprite*> result;
+        query(area, result);
+        return result;
+    }
+
+    void Quadtree::query(const sf::FloatRect& area, std::vector<Sprite*>& result) const {
+        result.clear();
+        query(area, [&result](Sprite* obj) { result.push_back(obj); });
+    }
+
+    bool Quadtree::contains(const sf::FloatRect& bounds) const {
+        return fitsInNode(0, bounds);
+    }
+
+    bool Quadtree::fitsInNode(int index, const sf::FloatRect& objBounds) const {
+        const sf::FloatRect& bounds = nodes[index].bounds;
+        return objBounds.left >= bounds.left && objBounds.top >= bounds.top &&
+               objBounds.left + objBounds.width <= bounds.left + bounds.width &&
+               objBounds.top + objBounds.height <= bounds.top + bounds.height;
+    }
+
+    int Quadtree::childContaining(int index, const sf::FloatRect& objBounds) const {
+        int first = nodes[index].firstChild;
+        if (first < 0) return -1;
+
+        for (int child = first; child < first + 4; ++child) {
+            if (fitsInNode(child, objBounds)) return child;
+        }
+        return -1; // straddles a split line, stays in this node
+    }
+
+    int Quadtree::allocateChildren(int index) {
+        int first;
+        if (!freeBlocks.empty()) {
+            first = freeBlocks.back();
+            freeBlocks.pop_back();
+        } else {
+            first = static_cast<int>(nodes.size());
+            nodes.resize(nodes.size() + 4); // may move the arena, so only hold indices across this call
+        }
+
+        const sf::FloatRect bounds = nodes[index].bounds;
+        const float halfWidth = bounds.width / 2;
+        const float halfHeight = bounds.height / 2;
+        const sf::FloatRect childBounds[4] = {
+            { bounds.left, bounds.top, halfWidth, halfHeight },
+            { bounds.left + halfWidth, bounds.top, halfWidth, halfHeight },
+            { bounds.left, bounds.top + halfHeight, halfWidth, halfHeight },
+            { bounds.left + halfWidth, bounds.top + halfHeight, halfWidth, halfHeight }
+        };
+
+        for (int i = 0; i < 4; ++i) {
+            Node& child = nodes[first + i];
+            child.bounds = childBounds[i];
+            child.level = nodes[index].level + 1;
+            child.parent = index;
+            child.firstChild = -1;
+            child.objects.clear(); // keeps the capacity from the block's previous use
+        }
+        nodes[index].firstChild = first;
+        return first;
+    }
+
+    void Quadtree::releaseChildren(int index) {
+        int first = nodes[index].firstChild;
+        if (first < 0) return;
+
+        for (int child = first; child < first + 4; ++child) {
+            releaseChildren(child);
+            nodes[child].objects.clear();
+        }
+        nodes[index].firstChild = -1;
+        freeBlocks.push_back(first);
+    }
+
+    void Quadtree::subdivide(int index) {
+        if (nodes[index].firstChild >= 0 || nodes[index].level >= maxLevels) return;
+
+        int first = allocateChildren(index);
+
+        // redistribute the objects that fit entirely inside one of the new children
+        scratch.clear();
+        std::swap(scratch, nodes[index].objects);
+        for (Sprite* obj : scratch) {
+            int child = childContaining(index, obj->returnSpritesShape().getGlobalBounds());
+            int target = child >= 0 ? child : index;
+            nodes[target].objects.push_back(obj);
+            objectNodes[obj] = target;
+        }
+        scratch.clear();
+
+        for (int child = first; child < first + 4; ++child) {
+            if (nodes[child].objects.size() > maxObjects) subdivide(child);
+        }
+    }
+
+    void Quadtree::insertInto(int index, Sprite* obj, const sf::FloatRect& objBounds) {
+        while (true) {
+            int child = childContaining(index, objBounds);
+            if (child < 0) break;
+            index = child;
+        }
+
+        nodes[index].objects.push_back(obj);
+        objectNodes[obj] = index;
+
+        if (nodes[index].firstChild < 0 && nodes[index].objects.size() > maxObjects) subdivide(index);
+    }
+
+    void Quadtree::detach(Sprite* obj, int index) {
+        auto& objects = nodes[index].objects;
+        auto it = std::find(objects.begin(), objects.end(), obj);
+        if (it != objects.end()) {
+            *it = objects.back();
+            objects.pop_back();
+        }
+    }
+
+    // collapses a node's children back into it once they are leaves holding few enough sprites
+    void Quadtree::tryMerge(int index) {
+        while (index >= 0) {
+            Node& node = nodes[index];
+            if (node.firstChild < 0) return;
+
+            size_t total = node.objects.size();
+            for (int child = node.firstChild; child < node.firstChild + 4; ++child) {
+                if (nodes[child].firstChild >= 0) return;
+                total += nodes[child].objects.size();
             }
+            if (total > maxObjects) return;
 
-            for (const auto& obj : objects) {
-                if (area.intersects(obj->returnSpritesShape().getGlobalBounds())) {
-                    result.push_back(obj);
-                    // log_info("Sprite added to query result at level " + std::to_string(level));
+            for (int child = node.firstChild; child < node.firstChild + 4; ++child) {
+                for (Sprite* obj : nodes[child].objects) {
+                    node.objects.push_back(obj);
+                    objectNodes[obj] = index;
                 }
             }
+            releaseChildren(index);
+            index = node.parent;
+        }
+    }
 
-            for (const auto& node : nodes) {
-                auto nodeResult = node->query(area);
-                result.insert(result.end(), nodeResult.begin(), nodeResult.end());
+    void Quadtree::update() {
+        // collect the movers whose bounds no longer match their node
+        movers.clear();
+        for (const auto& [obj, index] : objectNodes) {
+            if (index < 0 || !obj->getMoveState()) continue;
+
+            sf::FloatRect objBounds = obj->returnSpritesShape().getGlobalBounds();
+            bool leftNode = index != 0 && !fitsInNode(index, objBounds);
+            if (leftNode || childContaining(index, objBounds) >= 0) {
+                movers.push_back(obj);
             }
-            return result;
+        }
 
-        } catch (const std::exception& e) {
-            log_error("Error during query at level " + std::to_string(level) + ": " + std::string(e.what()));
-            return std::vector<Sprite*>();
+        for (Sprite* obj : movers) {
+            int oldIndex = objectNodes[obj];
+            sf::FloatRect objBounds = obj->returnSpritesShape().getGlobalBounds();
+            detach(obj, oldIndex);
+
+            // climb to the closest ancestor that still holds the sprite and re-insert from there
+            int index = oldIndex;
+            while (index != 0 && !fitsInNode(index, objBounds)) index = nodes[index].parent;
+            insertInto(index, obj, objBounds);
+
+            if (objectNodes[obj] != oldIndex) tryMerge(nodes[oldIndex].parent);
         }
+        movers.clear();
     }
 
-    bool Quadtree::contains(const sf::FloatRect& bounds) const {
-        try {
-            bool result = this->bounds.contains(bounds.left, bounds.top) &&
-                this->bounds.contains(bounds.left + bounds.width, bounds.top + bounds.height);
-            log_info(result ? "Bounds are contained in the quadtree at level " + std::to_string(level) :
-                            "Bounds are not contained in the quadtree at level " + std::to_string(level));
-            return result;
-        } catch (const std::exception& e) {
-            log_error("Error during contains check at level " + std::to_string(level) + ": " + std::string(e.what()));
-            return false;
-        }
+    SpatialGrid::SpatialGrid(float x, float y, float width, float height, float cellWidth, float cellHeight)
+        : worldBounds(x, y, width, height), cellWidth(cellWidth), cellHeight(cellHeight),
+          columns(std::max(1, static_cast<int>(std::ceil(width / cellWidth)))),
+          rows(std::max(1, static_cast<int>(std::ceil(height / cellHeight)))),
+          cells(static_cast<size_t>(columns) * rows) {}
+
+    void SpatialGrid::clear() {
+        for (auto& cell : cells) cell.clear();
+        records.clear();
+        freeRecords.clear();
+        recordIndices.clear();
+        log_info("Spatial grid cleared.");
+    }
+
+    // sprites outside the world are clamped into the border cells
+    SpatialGrid::CellRange SpatialGrid::cellRangeOf(const sf::FloatRect& area) const {
+        auto column = [this](float x) { return std::clamp(static_cast<int>(std::floor((x - worldBounds.left) / cellWidth)), 0, columns - 1); };
+        auto row = [this](float y) { return std::clamp(static_cast<int>(std::floor((y - worldBounds.top) / cellHeight)), 0, rows - 1); };
+        return { column(area.left), row(area.top), column(area.left + area.width), row(area.top + area.height) };
     }
 
-    void Quadtree::subdivide() {
-        try {
-            // Check if we've reached the max level
-            if (level >= maxLevels) {
-                log_info("Maximum level reached, cannot subdivide further.");
-                return;
+    void SpatialGrid::addToCells(uint32_t recordIndex) {
+        const CellRange& range = records[recordIndex].cells;
+        for (int row = range.top; row <= range.bottom; ++row) {
+            for (int column = range.left; column <= range.right; ++column) {
+                cells[row * columns + column].push_back(recordIndex);
             }
+        }
+    }
 
-            float halfWidth = bounds.width / 2;
-            float halfHeight = bounds.height / 2;
-            float x = bounds.left;
-            float y = bounds.top;
-
-            // Create four child nodes with smaller bounds and increment the level
-            nodes.push_back(std::make_unique<Quadtree>(x, y, halfWidth, halfHeight, level + 1, maxObjects, maxLevels));
-            nodes.push_back(std::make_unique<Quadtree>(x + halfWidth, y, halfWidth, halfHeight, level + 1, maxObjects, maxLevels));
-            nodes.push_back(std::make_unique<Quadtree>(x, y + halfHeight, halfWidth, halfHeight, level + 1, maxObjects, maxLevels));
-            nodes.push_back(std::make_unique<Quadtree>(x + halfWidth, y + halfHeight, halfWidth, halfHeight, level + 1, maxObjects, maxLevels));
-
-            log_info("Quadtree subdivided into 4 child nodes at level " + std::to_string(level));
-
-            // Redistribute the objects into the appropriate child nodes
-            for (auto it = objects.begin(); it != objects.end(); ) {
-                bool inserted = false;
-                for (auto& node : nodes) {
-                    if (node->bounds.intersects((*it)->returnSpritesShape().getGlobalBounds())) {
-                        node->objects.push_back(*it);
-                        it = objects.erase(it); // Remove object from the current node
-                        inserted = true;
-                        log_info("Sprite moved to child node at level " + std::to_string(node->level));
-                        break;
-                    }
-                }
-                if (!inserted) {
-                    ++it;
+    void SpatialGrid::removeFromCells(uint32_t recordIndex) {
+        const CellRange& range = records[recordIndex].cells;
+        for (int row = range.top; row <= range.bottom; ++row) {
+            for (int column = range.left; column <= range.right; ++column) {
+                auto& cell = cells[row * columns + column];
+                auto it = std::find(cell.begin(), cell.end(), recordIndex);
+                if (it != cell.end()) {
+                    *it = cell.back();
+                    cell.pop_back();
                 }
             }
-        } catch (const std::exception& e) {
-            log_error("Error during subdivision at level " + std::to_string(level) + ": " + std::string(e.what()));
         }
     }
 
-    void Quadtree::update() {
-        try {
-            for (auto& sprite : objects) {
-                // log_info("Updating quadtree at level " + std::to_string(level));
-
-                if (sprite->getMoveState()) {
-                    // Check which node the sprite was in
-                    for (auto& node : nodes) {
-                        if (node->contains(sprite->returnSpritesShape().getGlobalBounds())) {
-                            // Remove sprite from the old node
-                            node->objects.erase(std::remove(node->objects.begin(), node->objects.end(), sprite), node->objects.end());
-                            log_info("Sprite removed from old node at level " + std::to_string(node->level));
-                            break;
-                        }
-                    }
-
-                    // Insert the sprite back into the quadtree
-                    std::unique_ptr<Sprite> spritePtr(sprite);
-                    insert(spritePtr);
-                    log_info("Sprite updated and inserted into quadtree at level " + std::to_string(level));
+    void SpatialGrid::insert(Sprite* obj) {
+        if (!obj) return;
+        if (recordIndices.count(obj)) remove(obj);
+
+        uint32_t recordIndex;
+        if (!freeRecords.empty()) {
+            recordIndex = freeRecords.back();
+            freeRecords.pop_back();
+        } else {
+            recordIndex = static_cast<uint32_t>(records.size());
+            records.emplace_back();
+        }
+
+        Record& record = records[recordIndex];
+        record.sprite = obj;
+        record.enabled = true;
+        record.bounds = obj->returnSpritesShape().getGlobalBounds();
+        record.cells = cellRangeOf(record.bounds);
+        addToCells(recordIndex);
+        recordIndices[obj] = recordIndex;
+    }
+
+    void SpatialGrid::remove(Sprite* obj) {
+        auto it = recordIndices.find(obj);
+        if (it == recordIndices.end()) return;
+
+        if (records[it->second].enabled) removeFromCells(it->second);
+        records[it->second].sprite = nullptr;
+        freeRecords.push_back(it->second);
+        recordIndices.erase(it);
+    }
+
+    void SpatialGrid::setEnabled(Sprite* obj, bool enabled) {
+        auto it = recordIndices.find(obj);
+        if (it == recordIndices.end()) return;
+
+        Record& record = records[it->second];
+        if (record.enabled == enabled) return;
+        record.enabled = enabled;
+        if (!enabled) {
+            removeFromCells(it->second); // cells keep their capacity for when it comes back
+            return;
+        }
+        record.bounds = obj->returnSpritesShape().getGlobalBounds();
+        record.cells = cellRangeOf(record.bounds);
+        addToCells(it->second);
+    }
+
+    void SpatialGrid::update() {
+        for (uint32_t recordIndex = 0; recordIndex < records.size(); ++recordIndex) {
+            Record& record = records[recordIndex];
+            if (!record.sprite || !record.enabled || !record.sprite->getMoveState()) continue;
+
+            record.bounds = record.sprite->returnSpritesShape().getGlobalBounds();
+            CellRange range = cellRangeOf(record.bounds);
+            if (range != record.cells) { // only re-bucket sprites that crossed a cell border
+                removeFromCells(recordIndex);
+                record.cells = range;
+                addToCells(recordIndex);
+            }
+        }
+    }
+
+    void SpatialGrid::query(const sf::FloatRect& area, std::vector<Sprite*>& result) const {
+        result.clear();
+        query(area, [&result](Sprite* obj) { result.push_back(obj); });
+    }
+
+    void SweepAndPrune::clear() {
+        endpoints.clear();
+        records.clear();
+        freeRecords.clear();
+        recordIndices.clear();
+        xOverlaps.clear();
+        log_info("Sweep and prune cleared.");
+    }
+
+    // new endpoints start at the end of the array (right of everything, overlapping nothing) and get sorted into place
+    void SweepAndPrune::insert(Sprite* obj) {
+        if (!obj) return;
+        if (recordIndices.count(obj)) remove(obj);
+
+        uint32_t recordIndex;
+        if (!freeRecords.empty()) {
+            recordIndex = freeRecords.back();
+            freeRecords.pop_back();
+        } else {
+            recordIndex = static_cast<uint32_t>(records.size());
+            records.emplace_back();
+        }
+
+        Record& record = records[recordIndex];
+        record.sprite = obj;
+        record.enabled = true;
+        record.bounds = obj->returnSpritesShape().getGlobalBounds();
+        recordIndices[obj] = recordIndex;
+
+        endpoints.push_back({ record.bounds.left, recordIndex, true });
+        endpoints.push_back({ record.bounds.left + record.bounds.width, recordIndex, false });
+        sortEndpoints();
+    }
+
+    // pushing both endpoints past everything else ends all of the sprite's overlaps, then they can be dropped from the
+    // tail (disabled sprites park there too, so they aren't necessarily the last two)
+    void SweepAndPrune::remove(Sprite* obj) {
+        auto it = recordIndices.find(obj);
+        if (it == recordIndices.end()) return;
+
+        const uint32_t recordIndex = it->second;
+        records[recordIndex].enabled = false;
+        for (Endpoint& endpoint : endpoints) {
+            if (endpoint.record == recordIndex) endpoint.value = std::numeric_limits<float>::max();
+        }
+        sortEndpoints();
+        endpoints.erase(std::remove_if(endpoints.begin(), endpoints.end(), [recordIndex](const Endpoint& endpoint) { return endpoint.record == recordIndex; }), endpoints.end());
+
+        records[recordIndex].sprite = nullptr;
+        freeRecords.push_back(recordIndex);
+        recordIndices.erase(it);
+    }
+
+    // takes effect for queries and pairs right away; the endpoints move past the right end (or back) on the next update()
+    void SweepAndPrune::setEnabled(Sprite* obj, bool enabled) {
+        auto it = recordIndices.find(obj);
+        if (it == recordIndices.end()) return;
+
+        Record& record = records[it->second];
+        record.enabled = enabled;
+        if (enabled) record.bounds = obj->returnSpritesShape().getGlobalBounds();
+    }
+
+    void SweepAndPrune::update() {
+        refreshEndpoints();
+        sortEndpoints();
+    }
+
+    void SweepAndPrune::refreshEndpoints() {
+        for (Record& record : records) {
+            if (record.sprite && record.enabled && record.sprite->getMoveState()) record.bounds = record.sprite->returnSpritesShape().getGlobalBounds();
+        }
+        for (Endpoint& endpoint : endpoints) {
+            const Record& record = records[endpoint.record];
+            if (!record.enabled) { endpoint.value = std::numeric_limits<float>::max(); continue; }
+            endpoint.value = endpoint.isMin ? record.bounds.left : record.bounds.left + record.bounds.width;
+        }
+    }
+
+    // insertion sort; the only swaps that change an overlap are a min moving left past a max (the two start overlapping)
+    // and a max moving left past a min (they stop)
+    void SweepAndPrune::sortEndpoints() {
+        for (size_t i = 1; i < endpoints.size(); ++i) {
+            Endpoint moving = endpoints[i];
+            size_t j = i;
+            for (; j > 0 && comesBefore(moving, endpoints[j - 1]); --j) {
+                const Endpoint& passed = endpoints[j - 1];
+                if (moving.record != passed.record) {
+                    if (moving.isMin && !passed.isMin) addOverlap(pairKey(moving.record, passed.record));
+                    else if (!moving.isMin && passed.isMin) removeOverlap(pairKey(moving.record, passed.record));
                 }
+                endpoints[j] = passed;
             }
-        } catch (const std::exception& e) {
-            log_error("Error during update at level " + std::to_string(level) + ": " + std::string(e.what()));
+            endpoints[j] = moving;
+        }
+    }
+
+    void SweepAndPrune::addOverlap(uint64_t key) {
+        if (!records[static_cast<uint32_t>(key >> 32)].enabled || !records[static_cast<uint32_t>(key)].enabled) return; // parked together past the right end
+        auto it = std::lower_bound(xOverlaps.begin(), xOverlaps.end(), key);
+        if (it == xOverlaps.end() || *it != key) xOverlaps.insert(it, key);
+    }
+
+    void SweepAndPrune::removeOverlap(uint64_t key) {
+        auto it = std::lower_bound(xOverlaps.begin(), xOverlaps.end(), key);
+        if (it != xOverlaps.end() && *it == key) xOverlaps.erase(it);
+    }
+
+    void SweepAndPrune::query(const sf::FloatRect& area, std::vector<Sprite*>& result) const {
+        result.clear();
+        query(area, [&result](Sprite* obj) { result.push_back(obj); });
+    }
+
+    std::unique_ptr<Broadphase> makeBroadphase(PhysicsComponents::BroadphaseType type) {
+        const float worldWidth = static_cast<float>(Constants::WORLD_WIDTH);
+        const float worldHeight = static_cast<float>(Constants::WORLD_HEIGHT);
+
+        switch (type) {
+            case PhysicsComponents::BroadphaseType::GRID:
+                log_info("Using spatial grid broadphase");
+                return std::make_unique<SpatialGrid>(0.0f, 0.0f, worldWidth, worldHeight,
+                                                     Constants::TILE_WIDTH * Constants::TILES_SCALE.x, Constants::TILE_HEIGHT * Constants::TILES_SCALE.y);
+            case PhysicsComponents::BroadphaseType::SWEEP_AND_PRUNE:
+                log_info("Using sweep and prune broadphase");
+                return std::make_unique<SweepAndPrune>();
+            case PhysicsComponents::BroadphaseType::QUADTREE:
+            default:
+                log_info("Using quadtree broadphase");
+                return std::make_unique<Quadtree>(0.0f, 0.0f, worldWidth, worldHeight, Constants::QUADTREE_MAX_OBJECTS, Constants::QUADTREE_MAX_LEVELS);
         }
     }
 
-    // struct to hold raycast operation results that use vector of sprites
-    RaycastResult cachedRaycastResult {}; 
+    TimeOfImpactCache timeOfImpactCache {}; 
+
+    bool TimeOfImpactCache::find(const Sprite* sprite1, const Sprite* sprite2, sf::Vector2f velocity1, sf::Vector2f velocity2, Impact& impact) {
+        const PairKey key = makeKey(sprite1, sprite2);
+        if (key.first != sprite1) std::swap(velocity1, velocity2);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = impactTimes.find(key);
+        if (it == impactTimes.end()) return false;
+        if (it->second.velocity1 != velocity1 || it->second.velocity2 != velocity2) { // worked out for a path they're not on anymore
+            impactTimes.erase(it);
+            return false;
+        }
+        impact = it->second.impact;
+        return true;
+    }
+
+    void TimeOfImpactCache::store(const Sprite* sprite1, const Sprite* sprite2, sf::Vector2f velocity1, sf::Vector2f velocity2, Impact impact) {
+        const PairKey key = makeKey(sprite1, sprite2);
+        if (key.first != sprite1) std::swap(velocity1, velocity2);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        impactTimes[key] = Entry{ impact, velocity1, velocity2 };
+    }
+
+    void TimeOfImpactCache::evict(const Sprite* sprite1, const Sprite* sprite2) {
+        std::lock_guard<std::mutex> lock(mutex);
+        impactTimes.erase(makeKey(sprite1, sprite2));
+    }
+
+    void TimeOfImpactCache::evictSprite(const Sprite* sprite) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = impactTimes.begin(); it != impactTimes.end(); ) {
+            if (it->first.first == sprite || it->first.second == sprite) it = impactTimes.erase(it);
+            else ++it;
+        }
+    }
+
+    void TimeOfImpactCache::evictBefore(float time) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = impactTimes.begin(); it != impactTimes.end(); ) {
+            if (it->second.impact.time < time) it = impactTimes.erase(it);
+            else ++it;
+        }
+    }
+
+    void TimeOfImpactCache::clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        impactTimes.clear();
+    }
+
+    size_t TimeOfImpactCache::size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return impactTimes.size();
+    }
 
     // falling objects 
     sf::Vector2f freeFall( float speed, sf::Vector2f originalPos){
@@ -224,12 +627,150 @@ namespace physics {
         return distanceSquared <= radiusSumSquared;
     }
 
+    namespace {
+        constexpr size_t BATCH_PADDING = 8; // widest vector loop, in floats
+
+        size_t paddedSize(size_t count) { return (count + BATCH_PADDING - 1) / BATCH_PADDING * BATCH_PADDING; }
+
+        // grows the arrays to hold one more element, the new padding is NaN
+        void growBatch(size_t count, std::initializer_list<std::vector<float>*> arrays) {
+            const size_t padded = paddedSize(count + 1);
+            for (std::vector<float>* array : arrays) {
+                if (array->size() < padded) array->resize(padded, std::numeric_limits<float>::quiet_NaN());
+            }
+        }
+
+        // one box against the batch, writes hitWords(batch.size()) words
+        void boxRow(float left, float top, float right, float bottom, const AABBBatch& batch, uint64_t* row) {
+            std::fill(row, row + hitWords(batch.size()), 0);
+            if (!(left < right && top < bottom)) return; // empty boxes never overlap, same as boundingBoxCollision
+            size_t i = 0;
+        #if defined(__AVX__)
+            const __m256 left1 = _mm256_set1_ps(left), top1 = _mm256_set1_ps(top), right1 = _mm256_set1_ps(right), bottom1 = _mm256_set1_ps(bottom);
+            for (; i < batch.size(); i += 8) {
+                const __m256 overlapX = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&batch.left[i]), right1, _CMP_LT_OQ),
+                                                      _mm256_cmp_ps(left1, _mm256_loadu_ps(&batch.right[i]), _CMP_LT_OQ));
+                const __m256 overlapY = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(&batch.top[i]), bottom1, _CMP_LT_OQ),
+                                                      _mm256_cmp_ps(top1, _mm256_loadu_ps(&batch.bottom[i]), _CMP_LT_OQ));
+                row[i >> 6] |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_and_ps(overlapX, overlapY))) << (i & 63);
+            }
+        #elif defined(__SSE2__)
+            const __m128 left1 = _mm_set1_ps(left), top1 = _mm_set1_ps(top), right1 = _mm_set1_ps(right), bottom1 = _mm_set1_ps(bottom);
+            for (; i < batch.size(); i += 4) {
+                const __m128 overlapX = _mm_and_ps(_mm_cmplt_ps(_mm_loadu_ps(&batch.left[i]), right1), _mm_cmplt_ps(left1, _mm_loadu_ps(&batch.right[i])));
+                const __m128 overlapY = _mm_and_ps(_mm_cmplt_ps(_mm_loadu_ps(&batch.top[i]), bottom1), _mm_cmplt_ps(top1, _mm_loadu_ps(&batch.bottom[i])));
+                row[i >> 6] |= static_cast<uint64_t>(_mm_movemask_ps(_mm_and_ps(overlapX, overlapY))) << (i & 63);
+            }
+        #else
+            for (; i < batch.size(); ++i) {
+                const bool hit = batch.left[i] < right && left < batch.right[i] && batch.top[i] < bottom && top < batch.bottom[i];
+                row[i >> 6] |= static_cast<uint64_t>(hit) << (i & 63);
+            }
+        #endif
+        }
+
+        // one circle against the batch, writes hitWords(batch.size()) words
+        void circleRow(const sf::Vector2f& center, float radius, const CircleBatch& batch, uint64_t* row) {
+            std::fill(row, row + hitWords(batch.size()), 0);
+            size_t i = 0;
+        #if defined(__AVX__)
+            const __m256 x1 = _mm256_set1_ps(center.x), y1 = _mm256_set1_ps(center.y), radius1 = _mm256_set1_ps(radius);
+            for (; i < batch.size(); i += 8) {
+                const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&batch.x[i]), x1);
+                const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&batch.y[i]), y1);
+                const __m256 radiusSum = _mm256_add_ps(_mm256_loadu_ps(&batch.radius[i]), radius1);
+                const __m256 distanceSquared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+                const __m256 hit = _mm256_cmp_ps(distanceSquared, _mm256_mul_ps(radiusSum, radiusSum), _CMP_LE_OQ);
+                row[i >> 6] |= static_cast<uint64_t>(_mm256_movemask_ps(hit)) << (i & 63);
+            }
+        #elif defined(__SSE2__)
+            const __m128 x1 = _mm_set1_ps(center.x), y1 = _mm_set1_ps(center.y), radius1 = _mm_set1_ps(radius);
+            for (; i < batch.size(); i += 4) {
+                const __m128 dx = _mm_sub_ps(_mm_loadu_ps(&batch.x[i]), x1);
+                const __m128 dy = _mm_sub_ps(_mm_loadu_ps(&batch.y[i]), y1);
+                const __m128 radiusSum = _mm_add_ps(_mm_loadu_ps(&batch.radius[i]), radius1);
+                const __m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+                const __m128 hit = _mm_cmple_ps(distanceSquared, _mm_mul_ps(radiusSum, radiusSum));
+                row[i >> 6] |= static_cast<uint64_t>(_mm_movemask_ps(hit)) << (i & 63);
+            }
+        #else
+            for (; i < batch.size(); ++i) {
+                const float dx = batch.x[i] - center.x, dy = batch.y[i] - center.y, radiusSum = batch.radius[i] + radius;
+                row[i >> 6] |= static_cast<uint64_t>(dx * dx + dy * dy <= radiusSum * radiusSum) << (i & 63);
+            }
+        #endif
+        }
+    }
+
+    void AABBBatch::clear() {
+        left.clear(); top.clear(); right.clear(); bottom.clear();
+        count = 0;
+    }
+
+    void AABBBatch::reserve(size_t capacity) {
+        for (auto* array : { &left, &top, &right, &bottom }) array->reserve(paddedSize(capacity));
+    }
+
+    void AABBBatch::add(const sf::FloatRect& bounds) {
+        growBatch(count, { &left, &top, &right, &bottom });
+        if (!(bounds.width > 0.0f && bounds.height > 0.0f)) { // empty boxes never overlap, so they keep their NaN padding
+            ++count;
+            return;
+        }
+        left[count] = bounds.left;
+        top[count] = bounds.top;
+        right[count] = bounds.left + bounds.width;
+        bottom[count] = bounds.top + bounds.height;
+        ++count;
+    }
+
+    void CircleBatch::clear() {
+        x.clear(); y.clear(); radius.clear();
+        count = 0;
+    }
+
+    void CircleBatch::reserve(size_t capacity) {
+        for (auto* array : { &x, &y, &radius }) array->reserve(paddedSize(capacity));
+    }
+
+    void CircleBatch::add(const sf::Vector2f& center, float circleRadius) {
+        growBatch(count, { &x, &y, &radius });
+        x[count] = center.x;
+        y[count] = center.y;
+        radius[count] = circleRadius;
+        ++count;
+    }
+
+    void boundingBoxCollisionBatch(const sf::FloatRect& bounds, const AABBBatch& batch, std::vector<uint64_t>& hits) {
+        hits.resize(hitWords(batch.size()));
+        boxRow(bounds.left, bounds.top, bounds.left + bounds.width, bounds.top + bounds.height, batch, hits.data());
+    }
+
+    void circleCollisionBatch(const sf::Vector2f& center, float radius, const CircleBatch& batch, std::vector<uint64_t>& hits) {
+        hits.resize(hitWords(batch.size()));
+        circleRow(center, radius, batch, hits.data());
+    }
+
+    void boundingBoxCollisionBatch(const AABBBatch& batch1, const AABBBatch& batch2, std::vector<uint64_t>& hits) {
+        const size_t rowWords = hitWords(batch2.size());
+        hits.resize(batch1.size() * rowWords);
+        for (size_t i = 0; i < batch1.size(); ++i) {
+            boxRow(batch1.left[i], batch1.top[i], batch1.right[i], batch1.bottom[i], batch2, hits.data() + i * rowWords);
+        }
+    }
+
+    void circleCollisionBatch(const CircleBatch& batch1, const CircleBatch& batch2, std::vector<uint64_t>& hits) {
+        const size_t rowWords = hitWords(batch2.size());
+        hits.resize(batch1.size() * rowWords);
+        for (size_t i = 0; i < batch1.size(); ++i) {
+            circleRow({ batch1.x[i], batch1.y[i] }, batch1.radius[i], batch2, hits.data() + i * rowWords);
+        }
+    }
+
     // raycast collision 
     bool raycastPreCollision(const sf::Vector2f obj1position, const sf::Vector2f obj1direction, float obj1Speed, const sf::FloatRect obj1Bounds, sf::Vector2f obj1Acceleration, 
-                                const sf::Vector2f obj2position, const sf::Vector2f obj2direction, float obj2Speed, const sf::FloatRect obj2Bounds, sf::Vector2f obj2Acceleration) {
-            
-        ++cachedRaycastResult.counter;
-        std::cout << "calculating raycast collision time" << std::endl; 
+                                const sf::Vector2f obj2position, const sf::Vector2f obj2direction, float obj2Speed, const sf::FloatRect obj2Bounds, sf::Vector2f obj2Acceleration,
+                                float& timeToImpact) {
 
         // Calculate the initial relative velocity (obj1 velocity minus obj2 velocity)
         sf::Vector2f relativeVelocity = obj1direction * obj1Speed - obj2direction * obj2Speed;
@@ -244,8 +785,7 @@ namespace physics {
 
         // Avoid division by zero or invalid values
         if (velocityDot == 0  && (relativeAcceleration.x == 0 && relativeAcceleration.y == 0)) {
-            std::cout << "No relative motion or acceleration; no collision possible." << std::endl;
-            return false;
+            return false; // No relative motion or acceleration; no collision possible
         }
 
         // Time of closest approach considering relative acceleration
@@ -256,8 +796,7 @@ namespace physics {
             if (velocityDot != 0) {
                 timeToClosestApproach = -positionVelocityDot / velocityDot;
             } else {
-                std::cout << "No relative velocity detected; no collision possible." << std::endl;
-                return false;
+                return false; // No relative velocity detected; no collision possible
             }
         } else {
             // Case with relative acceleration: solve the quadratic equation
@@ -274,8 +813,7 @@ namespace physics {
             float discriminant = b * b - 4.0f * a * c;
 
             if (discriminant < 0) {
-                std::cout << "No collision; discriminant < 0." << std::endl;
-                return false;
+                return false; // No collision; discriminant < 0
             }
 
             // Calculate the two possible times of closest approach
@@ -287,17 +825,11 @@ namespace physics {
             timeToClosestApproach = std::min(time1, time2);
             
             if (timeToClosestApproach < 0) {
-                std::cout << "Closest approach is in the past." << std::endl;
-                return false;
+                return false; // Closest approach is in the past
             }
         }
 
-        // Store the calculated time of closest approach
-        cachedRaycastResult.collisionTimes.emplace_back(timeToClosestApproach);
-
-        // Log the calculated time for debugging
-        std::cout << "Calculated Time to Closest Approach: " << timeToClosestApproach << std::endl;
-
+        timeToImpact = timeToClosestApproach;
         return true;
     }
 
@@ -312,43 +844,123 @@ namespace physics {
         return !(xOverlapStart >= xOverlapEnd || yOverlapStart >= yOverlapEnd); 
     }
 
-    bool pixelPerfectCollision( const std::shared_ptr<sf::Uint8[]>& bitmask1, const sf::Vector2f& position1, const sf::Vector2f& size1,
-                                const std::shared_ptr<sf::Uint8[]>& bitmask2, const sf::Vector2f& position2, const sf::Vector2f& size2) {
+    namespace {
+        // word k of a row read from bit (64 * k + shift), the padding word at the end of each row keeps k + 1 in bounds
+        inline uint64_t shiftedWord(const uint64_t* row, unsigned int k, unsigned int shift) {
+            return shift ? (row[k] >> shift) | (row[k + 1] << (64 - shift)) : row[k];
+        }
+
+        // world space box a mask's bits can occupy; opaque bounds when they are known
+        sf::IntRect occupiedRect(const Bitmask& bitmask, const sf::Vector2i& position) {
+            if (!bitmask.hasCoarseLevels()) return { position.x, position.y, static_cast<int>(bitmask.width), static_cast<int>(bitmask.height) };
+            return { position.x + bitmask.opaqueBounds.left, position.y + bitmask.opaqueBounds.top, bitmask.opaqueBounds.width, bitmask.opaqueBounds.height };
+        }
 
-        // Helper function to get the pixel index in the bitmask
-        auto getPixelIndex = [](const sf::Vector2f& size, int x, int y) -> int {
-            return (y * static_cast<int>(size.x) + x) * 4; // Each pixel has 4 bytes (RGBA)
-        };
+        // full resolution test limited to area, which has to lie inside both masks. each mask is read from its own bit offset, the
+        // offsets are the same for every row so a row is just shifted words ANDed together
+        bool overlapInArea(const Bitmask& bitmask1, const sf::Vector2i& position1, const Bitmask& bitmask2, const sf::Vector2i& position2,
+                           const sf::IntRect& area) {
+            const unsigned int offset1 = static_cast<unsigned int>(area.left - position1.x);
+            const unsigned int offset2 = static_cast<unsigned int>(area.left - position2.x);
+            const unsigned int shift1 = offset1 & 63;
+            const unsigned int shift2 = offset2 & 63;
+            const unsigned int span = static_cast<unsigned int>(area.width);
+            const unsigned int fullWords = span >> 6;
+            const uint64_t tailMask = (span & 63) ? (uint64_t(1) << (span & 63)) - 1 : 0;
+
+        #if defined(__AVX2__)
+            const __m128i shiftRight1 = _mm_cvtsi32_si128(static_cast<int>(shift1));
+            const __m128i shiftLeft1 = _mm_cvtsi32_si128(static_cast<int>(64 - shift1)); // a shift of 64 gives 0, so shift == 0 needs no branch
+            const __m128i shiftRight2 = _mm_cvtsi32_si128(static_cast<int>(shift2));
+            const __m128i shiftLeft2 = _mm_cvtsi32_si128(static_cast<int>(64 - shift2));
+            auto load = [](const uint64_t* words) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words)); };
+        #elif defined(__SSE2__)
+            const __m128i shiftRight1 = _mm_cvtsi32_si128(static_cast<int>(shift1));
+            const __m128i shiftLeft1 = _mm_cvtsi32_si128(static_cast<int>(64 - shift1));
+            const __m128i shiftRight2 = _mm_cvtsi32_si128(static_cast<int>(shift2));
+            const __m128i shiftLeft2 = _mm_cvtsi32_si128(static_cast<int>(64 - shift2));
+            const __m128i zero = _mm_setzero_si128();
+            auto load = [](const uint64_t* words) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(words)); };
+        #endif
+
+            for (int y = area.top; y < area.top + area.height; ++y) {
+                const uint64_t* row1 = bitmask1.row(static_cast<unsigned int>(y - position1.y)) + (offset1 >> 6);
+                const uint64_t* row2 = bitmask2.row(static_cast<unsigned int>(y - position2.y)) + (offset2 >> 6);
+                unsigned int k = 0;
+
+            #if defined(__AVX2__)
+                for (; k + 4 <= fullWords; k += 4) {
+                    const __m256i words1 = _mm256_or_si256(_mm256_srl_epi64(load(row1 + k), shiftRight1), _mm256_sll_epi64(load(row1 + k + 1), shiftLeft1));
+                    const __m256i words2 = _mm256_or_si256(_mm256_srl_epi64(load(row2 + k), shiftRight2), _mm256_sll_epi64(load(row2 + k + 1), shiftLeft2));
+                    if (!_mm256_testz_si256(words1, words2)) return true;
+                }
+            #elif defined(__SSE2__)
+                for (; k + 2 <= fullWords; k += 2) {
+                    const __m128i words1 = _mm_or_si128(_mm_srl_epi64(load(row1 + k), shiftRight1), _mm_sll_epi64(load(row1 + k + 1), shiftLeft1));
+                    const __m128i words2 = _mm_or_si128(_mm_srl_epi64(load(row2 + k), shiftRight2), _mm_sll_epi64(load(row2 + k + 1), shiftLeft2));
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(words1, words2), zero)) != 0xFFFF) return true;
+                }
+            #endif
 
-        // Calculate the overlapping area between the two objects
-        float left = std::max(position1.x, position2.x);
-        float top = std::max(position1.y, position2.y);
-        float right = std::min(position1.x + size1.x, position2.x + size2.x);
-        float bottom = std::min(position1.y + size1.y, position2.y + size2.y);
+                for (; k < fullWords; ++k) {
+                    if (shiftedWord(row1, k, shift1) & shiftedWord(row2, k, shift2)) return true;
+                }
+                if (tailMask && (shiftedWord(row1, k, shift1) & shiftedWord(row2, k, shift2) & tailMask)) return true;
+            }
+            return false;
+        }
 
-        // Check AABB collision first
-        if (left >= right || top >= bottom) return false; 
-
-        // Check each pixel in the overlapping area
-        for (int y = static_cast<int>(top); y < static_cast<int>(bottom); ++y) {
-            for (int x = static_cast<int>(left); x < static_cast<int>(right); ++x) {
-                // Calculate the position in each bitmask
-                int x1 = x - static_cast<int>(position1.x);
-                int y1 = y - static_cast<int>(position1.y);
-                int x2 = x - static_cast<int>(position2.x);
-                int y2 = y - static_cast<int>(position2.y);
-
-                // Get the index of the pixel in each bitmask
-                int index1 = getPixelIndex(size1, x1, y1);
-                int index2 = getPixelIndex(size2, x2, y2);
-
-                // Check if the pixels' values are non-zero (i.e., not transparent)
-                if (bitmask1[index1] == 1 && bitmask2[index2] == 1) {
-                // std::cout << "Collision detected at pixel (" << x << ", " << y << ")" << std::endl;
-                    return true; // Collision detected
+        bool overlapAnywhere(const Bitmask& bitmask1, const sf::Vector2i& position1, const Bitmask& bitmask2, const sf::Vector2i& position2) {
+            sf::IntRect area;
+            const sf::IntRect rect1(position1.x, position1.y, static_cast<int>(bitmask1.width), static_cast<int>(bitmask1.height));
+            const sf::IntRect rect2(position2.x, position2.y, static_cast<int>(bitmask2.width), static_cast<int>(bitmask2.height));
+            return rect1.intersects(rect2, area) && overlapInArea(bitmask1, position1, bitmask2, position2, area);
+        }
+
+        // block grids of the two masks don't line up, so a block of mask 1 can touch two neighbouring blocks of mask 2 on each
+        // axis; the level test tries each of those (up to four) block alignments
+        bool coarseLevelOverlap(const Bitmask& bitmask1, const sf::Vector2i& position1, const Bitmask& bitmask2, const sf::Vector2i& position2, size_t level) {
+            const int blockSize = static_cast<int>(Bitmask::COARSE_BLOCK_SIZES[level]);
+            auto floorDiv = [](int value, int divisor) { return value / divisor - (value % divisor != 0 && value < 0); };
+            const sf::Vector2i offset = position2 - position1;
+            const sf::Vector2i blocks{ floorDiv(offset.x, blockSize), floorDiv(offset.y, blockSize) };
+            const int extraX = (offset.x % blockSize != 0);
+            const int extraY = (offset.y % blockSize != 0);
+
+            for (int dy = 0; dy <= extraY; ++dy) {
+                for (int dx = 0; dx <= extraX; ++dx) {
+                    if (overlapAnywhere(bitmask1.coarseLevels[level], {0, 0}, bitmask2.coarseLevels[level], { blocks.x + dx, blocks.y + dy })) return true;
                 }
             }
+            return false;
         }
-        return false; 
+    }
+
+    bool bitmasksMayOverlap(const Bitmask& bitmask1, const sf::Vector2i& position1, const Bitmask& bitmask2, const sf::Vector2i& position2) {
+        if (!occupiedRect(bitmask1, position1).intersects(occupiedRect(bitmask2, position2))) return false;
+        if (!bitmask1.hasCoarseLevels() || !bitmask2.hasCoarseLevels()) return true;
+
+        for (size_t level = bitmask1.coarseLevels.size(); level-- > 0; ) { // coarsest first
+            if (!coarseLevelOverlap(bitmask1, position1, bitmask2, position2, level)) return false;
+        }
+        return true;
+    }
+
+    bool bitmasksOverlap(const Bitmask& bitmask1, const sf::Vector2i& position1, const Bitmask& bitmask2, const sf::Vector2i& position2) {
+        sf::IntRect area; // only the overlap of the opaque parts needs a full resolution look
+        if (!occupiedRect(bitmask1, position1).intersects(occupiedRect(bitmask2, position2), area)) return false;
+        return bitmasksMayOverlap(bitmask1, position1, bitmask2, position2) && overlapInArea(bitmask1, position1, bitmask2, position2, area);
+    }
+
+    bool pixelPerfectCollision( const std::shared_ptr<Bitmask>& bitmask1, const sf::Vector2f& position1, const sf::Vector2f& size1,
+                                const std::shared_ptr<Bitmask>& bitmask2, const sf::Vector2f& position2, const sf::Vector2f& size2) {
+
+        // Check AABB collision first
+        if (!boundingBoxCollision(position1, size1, position2, size2)) return false; 
+
+        // sprites without a mask count as fully solid
+        if (!bitmask1 || !bitmask2) return true; 
+
+        return bitmasksOverlap(*bitmask1, toPixelPosition(position1), *bitmask2, toPixelPosition(position2)); 
     }
 }
\ No newline at end of file
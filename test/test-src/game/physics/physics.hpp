@@ -10,6 +10,11 @@
 #include <math.h>
 #include <functional> 
 #include <utility>
+#include <unordered_map>
+#include <limits>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
 
 #include "../../test-assets/sprites/sprites.hpp" 
 #include "../../test-assets/tiles/tiles.hpp" 
@@ -17,44 +22,267 @@
 
 namespace physics{
 
-    class Quadtree {
+    // common interface for the broadphase structures a scene can pick in config.yaml, so they can be swapped and benchmarked
+    class Broadphase {
     public:
-        Quadtree(float x, float y, float width, float height, size_t level = 0, size_t maxObjects = 10, size_t maxLevels = 5);
-        ~Quadtree(){ clear(); };
-        void clear();
+        virtual ~Broadphase() = default;
+        virtual void clear() = 0;
+
+        template<typename SpriteType> void insert(std::unique_ptr<SpriteType>& obj) { insert(obj.get()); }
+        virtual void insert(Sprite* obj) = 0;
+        virtual void remove(Sprite* obj) = 0;
+        // a disabled sprite stays tracked but is left out of updates, queries and pairs until it is enabled again, so idle
+        // pooled sprites cost nothing and coming back doesn't allocate
+        virtual void setEnabled(Sprite* obj, bool enabled) = 0;
+        virtual void update() = 0; 
+        virtual void query(const sf::FloatRect& area, std::vector<Sprite*>& result) const = 0; // clears and refills a caller-owned buffer
+        virtual void forEachPotentialPair(const std::function<void(Sprite*, Sprite*)>& callback) = 0; // non-const, walks may use scratch state
+        virtual size_t size() const = 0;
+    };
+
+    /* Quadtree whose nodes live in a pooled arena (children are allocated as blocks of four and recycled through a free list).
+    A leaf splits once it holds more than maxObjects; sprites are kept in the deepest node that fully contains their bounds,
+    and update() only relocates movers whose bounds left their node. Sprites stay owned by the scene, so remove() them before deleting */
+    class Quadtree : public Broadphase {
+    public:
+        Quadtree(float x, float y, float width, float height, size_t maxObjects = 10, size_t maxLevels = 5);
+        ~Quadtree() override { clear(); };
+        void clear() override;
+
+        using Broadphase::insert;
+        void insert(Sprite* obj) override;
+        void remove(Sprite* obj) override;
+        void setEnabled(Sprite* obj, bool enabled) override;
+        std::vector<Sprite*> query(const sf::FloatRect& area) const;
+        void query(const sf::FloatRect& area, std::vector<Sprite*>& result) const override;
+        template<typename Visitor> void query(const sf::FloatRect& area, Visitor&& visitor) const { queryNode(0, area, visitor); } // visitor(Sprite*)
+        bool contains(const sf::FloatRect& bounds) const;
+        void update() override; 
+
+        // walks the tree once and calls callback(Sprite*, Sprite*) for every unique pair whose bounds overlap. the ancestor
+        // stack is a member, so the callback must not walk pairs again, and one walk at a time per tree
+        template<typename Callback> void forEachPotentialPair(Callback&& callback) {
+            pairCandidates.clear();
+            collectPairs(0, callback);
+        }
+        void forEachPotentialPair(const std::function<void(Sprite*, Sprite*)>& callback) override { forEachPotentialPair<const std::function<void(Sprite*, Sprite*)>&>(callback); }
+
+        size_t size() const override { return objectNodes.size(); }
+        size_t getNodeCount() const { return nodes.size() - freeBlocks.size() * 4; }
+
+    private:
+        struct Node {
+            sf::FloatRect bounds;
+            size_t level {};
+            int parent = -1;
+            int firstChild = -1; // the four children sit next to each other in the arena
+            std::vector<Sprite*> objects;
+        };
+
+        int allocateChildren(int index);
+        void releaseChildren(int index);
+        void subdivide(int index);
+        void insertInto(int index, Sprite* obj, const sf::FloatRect& objBounds);
+        void detach(Sprite* obj, int index);
+        void tryMerge(int index);
+        int childContaining(int index, const sf::FloatRect& objBounds) const;
+        bool fitsInNode(int index, const sf::FloatRect& objBounds) const;
+
+        // recursion depth is bounded by maxLevels, so the walk needs no heap-allocated stack
+        template<typename Visitor> void queryNode(int index, const sf::FloatRect& area, Visitor& visitor) const {
+            const Node& node = nodes[index];
+            // the root also keeps sprites that went outside the world, so it is always searched
+            if (index != 0 && !node.bounds.intersects(area)) return;
+
+            for (Sprite* obj : node.objects) {
+                if (area.intersects(obj->returnSpritesShape().getGlobalBounds())) visitor(obj);
+            }
+
+            if (node.firstChild >= 0) {
+                for (int child = node.firstChild; child < node.firstChild + 4; ++child) queryNode(child, area, visitor);
+            }
+        }
+
+        struct PairCandidate {
+            Sprite* sprite;
+            sf::FloatRect bounds;
+        };
+
+        // a sprite can only overlap sprites in its own node, its ancestors or its descendants, so each node is tested
+        // against the candidates gathered on the way down from the root
+        template<typename Callback> void collectPairs(int index, Callback& callback) {
+            const Node& node = nodes[index];
+            const size_t base = pairCandidates.size();
+
+            for (Sprite* obj : node.objects) {
+                sf::FloatRect objBounds = obj->returnSpritesShape().getGlobalBounds();
+                for (size_t i = 0; i < pairCandidates.size(); ++i) {
+                    if (objBounds.intersects(pairCandidates[i].bounds)) callback(pairCandidates[i].sprite, obj);
+                }
+                pairCandidates.push_back({ obj, objBounds });
+            }
+
+            if (node.firstChild >= 0) {
+                for (int child = node.firstChild; child < node.firstChild + 4; ++child) collectPairs(child, callback);
+            }
+            pairCandidates.resize(base);
+        }
 
-        template<typename SpriteType> void insert(std::unique_ptr<SpriteType>& obj) { 
-            try {
-                if (nodes.empty()) { // If no child nodes exist, add the object to this node
-                    objects.push_back(obj.get());
-                    log_info("Sprite inserted into quadtree node.");
-                } else { // Check which child node the object belongs to
-                    for (auto& node : nodes) {
-                        if (node->bounds.contains(obj->returnSpritesShape().getPosition())) {
-                            node->insert(obj);
-                            log_info("Sprite inserted into child node.");
-                            return;
+        size_t maxObjects;
+        size_t maxLevels;
+        std::vector<Node> nodes; // arena, nodes[0] is the root
+        std::vector<int> freeBlocks; // first index of every released block of four children
+        std::unordered_map<Sprite*, int> objectNodes; // node each sprite currently lives in, -1 while it's disabled
+        std::vector<Sprite*> scratch; // reused while subdivide() redistributes a node's sprites
+        std::vector<Sprite*> movers; // reused by update(); apart from scratch since relocating a mover can subdivide
+        std::vector<PairCandidate> pairCandidates; // ancestor stack reused by forEachPotentialPair
+    };
+
+    /* Uniform grid over the bounded world (cells are normally one tile in size). Every sprite is bucketed into each cell its
+    bounds touch, so insert/remove are O(cells covered) and queries only visit the cells under the area. Sprites and their
+    bounds live in one flat record array that update() walks linearly; bounds are refreshed for movers on every update() */
+    class SpatialGrid : public Broadphase {
+    public:
+        SpatialGrid(float x, float y, float width, float height, float cellWidth, float cellHeight);
+        ~SpatialGrid() override = default;
+        void clear() override;
+
+        using Broadphase::insert;
+        void insert(Sprite* obj) override;
+        void remove(Sprite* obj) override;
+        void setEnabled(Sprite* obj, bool enabled) override;
+        void update() override;
+        void query(const sf::FloatRect& area, std::vector<Sprite*>& result) const override;
+        size_t size() const override { return recordIndices.size(); }
+
+        template<typename Visitor> void query(const sf::FloatRect& area, Visitor&& visitor) const { // visitor(Sprite*)
+            const CellRange range = cellRangeOf(area);
+            for (int row = range.top; row <= range.bottom; ++row) {
+                for (int column = range.left; column <= range.right; ++column) {
+                    for (uint32_t recordIndex : cells[row * columns + column]) {
+                        const Record& record = records[recordIndex];
+                        // report a sprite spanning several cells only from the first cell it shares with the area
+                        if (column != std::max(record.cells.left, range.left) || row != std::max(record.cells.top, range.top)) continue;
+                        if (area.intersects(record.bounds)) visitor(record.sprite);
+                    }
+                }
+            }
+        }
+
+        template<typename Callback> void forEachPotentialPair(Callback&& callback) {
+            for (int row = 0; row < rows; ++row) {
+                for (int column = 0; column < columns; ++column) {
+                    const std::vector<uint32_t>& cell = cells[row * columns + column];
+                    for (size_t i = 0; i < cell.size(); ++i) {
+                        const Record& record1 = records[cell[i]];
+                        for (size_t j = i + 1; j < cell.size(); ++j) {
+                            const Record& record2 = records[cell[j]];
+                            // pairs sharing several cells are only reported from the first shared one
+                            if (column != std::max(record1.cells.left, record2.cells.left) || row != std::max(record1.cells.top, record2.cells.top)) continue;
+                            if (record1.bounds.intersects(record2.bounds)) callback(record1.sprite, record2.sprite);
                         }
                     }
                 }
-            } catch (const std::exception& e) {
-                log_error("Error during insert: " + std::string(e.what()));
             }
         }
-        std::vector<Sprite*> query(const sf::FloatRect& area) const;
-        void subdivide();
-        bool contains(const sf::FloatRect& bounds) const;
-        void update(); 
+        void forEachPotentialPair(const std::function<void(Sprite*, Sprite*)>& callback) override { forEachPotentialPair<const std::function<void(Sprite*, Sprite*)>&>(callback); }
 
     private:
-        size_t maxObjects;
-        size_t maxLevels;
-        size_t level;
-        sf::FloatRect bounds;
-        std::vector<Sprite*> objects;
-        std::vector<std::unique_ptr<Quadtree>> nodes;
+        struct CellRange { // inclusive cell indices
+            int left, top, right, bottom;
+            bool operator!=(const CellRange& other) const { return left != other.left || top != other.top || right != other.right || bottom != other.bottom; }
+        };
+        struct Record {
+            Sprite* sprite = nullptr; // nullptr marks a free record
+            sf::FloatRect bounds;
+            CellRange cells; // a disabled record isn't in any cell
+            bool enabled = true;
+        };
+
+        CellRange cellRangeOf(const sf::FloatRect& area) const;
+        void addToCells(uint32_t recordIndex);
+        void removeFromCells(uint32_t recordIndex);
+
+        sf::FloatRect worldBounds;
+        float cellWidth;
+        float cellHeight;
+        int columns;
+        int rows;
+        std::vector<std::vector<uint32_t>> cells; // row-major, each holds indices into records
+        std::vector<Record> records;
+        std::vector<uint32_t> freeRecords;
+        std::unordered_map<Sprite*, uint32_t> recordIndices;
     };
 
+    /* Sweep and prune along x. Both x endpoints of every sprite are kept in one sorted array that update() re-sorts with
+    insertion sort; movers only shift a little each frame, so that is close to linear. Each swap of a min past a max (or the
+    other way round) starts or ends an x overlap, which keeps the set of x-overlapping pairs up to date without rebuilding it.
+    Reported pairs are the x-overlapping ones whose bounds also meet on y */
+    class SweepAndPrune : public Broadphase {
+    public:
+        SweepAndPrune() = default;
+        ~SweepAndPrune() override = default;
+        void clear() override;
+
+        using Broadphase::insert;
+        void insert(Sprite* obj) override;
+        void remove(Sprite* obj) override;
+        void setEnabled(Sprite* obj, bool enabled) override;
+        void update() override;
+        void query(const sf::FloatRect& area, std::vector<Sprite*>& result) const override;
+        size_t size() const override { return recordIndices.size(); }
+        size_t getOverlapCount() const { return xOverlaps.size(); } // pairs overlapping on x, before the y check
+
+        template<typename Visitor> void query(const sf::FloatRect& area, Visitor&& visitor) const { // visitor(Sprite*)
+            const float right = area.left + area.width;
+            for (const Endpoint& endpoint : endpoints) {
+                if (endpoint.value > right) break; // everything after starts to the right of the area
+                if (!endpoint.isMin) continue;
+                const Record& record = records[endpoint.record];
+                if (record.enabled && area.intersects(record.bounds)) visitor(record.sprite);
+            }
+        }
+
+        template<typename Callback> void forEachPotentialPair(Callback&& callback) {
+            for (uint64_t key : xOverlaps) {
+                const Record& record1 = records[static_cast<uint32_t>(key >> 32)];
+                const Record& record2 = records[static_cast<uint32_t>(key)];
+                // a pair disabled since the last update() is only dropped by the next sort
+                if (record1.enabled && record2.enabled && record1.bounds.intersects(record2.bounds)) callback(record1.sprite, record2.sprite);
+            }
+        }
+        void forEachPotentialPair(const std::function<void(Sprite*, Sprite*)>& callback) override { forEachPotentialPair<const std::function<void(Sprite*, Sprite*)>&>(callback); }
+
+    private:
+        struct Endpoint {
+            float value;
+            uint32_t record;
+            bool isMin;
+        };
+        struct Record {
+            Sprite* sprite = nullptr; // nullptr marks a free record
+            sf::FloatRect bounds;
+            bool enabled = true; // disabled endpoints sit past the right end and never start an overlap
+        };
+
+        // sort order along x; on equal values mins go first so touching sprites still count as overlapping
+        static bool comesBefore(const Endpoint& a, const Endpoint& b) { return a.value < b.value || (a.value == b.value && a.isMin && !b.isMin); }
+        static uint64_t pairKey(uint32_t a, uint32_t b) { return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a; }
+        void refreshEndpoints();
+        void sortEndpoints();
+        void addOverlap(uint64_t key);
+        void removeOverlap(uint64_t key);
+
+        std::vector<Endpoint> endpoints; // sorted along x
+        std::vector<Record> records;
+        std::vector<uint32_t> freeRecords;
+        std::unordered_map<Sprite*, uint32_t> recordIndices;
+        std::vector<uint64_t> xOverlaps; // sorted, persists between frames. a flat array keeps its capacity, so pairs starting and ending don't allocate once it has grown
+    };
+
+    // makes the broadphase picked in config.yaml, sized to the world; grid cells are one (scaled) tile
+    std::unique_ptr<Broadphase> makeBroadphase(PhysicsComponents::BroadphaseType type);
+
     // moving object
     constexpr float gravity = 9.8f;
     sf::Vector2f freeFall(float speed, sf::Vector2f originalPo);
@@ -70,7 +298,7 @@ namespace physics{
     sf::Vector2f followDirVecOpposite(float speed, sf::Vector2f originalPos, sf::Vector2f acceleration, const sf::Vector2f& direction); 
 
     template<typename SpriteType, typename MoveFunc, typename... Args>
-    void spriteMover(std::unique_ptr<SpriteType>& sprite, const MoveFunc& moveFunc, Args&&... args) {
+    void spriteMover(SpriteType* sprite, const MoveFunc& moveFunc, Args&&... args) {
         float speed = sprite->getSpeed();
         sf::Vector2f originalPos = sprite->getSpritePos();
 
@@ -96,19 +324,115 @@ namespace physics{
         sprite->updatePos();
     }
 
+    template<typename SpriteType, typename MoveFunc, typename... Args>
+    void spriteMover(std::unique_ptr<SpriteType>& sprite, const MoveFunc& moveFunc, Args&&... args) {
+        spriteMover(sprite.get(), moveFunc, std::forward<Args>(args)...);
+    }
+
     // collision methods
     bool circleCollision(const sf::Vector2f pos1, float radius1, const sf::Vector2f pos2, float radius2);
-    // raycast pre-collision in 2D space
-    struct RaycastResult {
-        std::vector<float> collisionTimes;
-        int counter; 
-    };    
-    extern RaycastResult cachedRaycastResult; 
+    // raycast pre-collision in 2D space; writes how long until the closest approach, false if the pair never gets closer
     bool raycastPreCollision(const sf::Vector2f obj1position, const sf::Vector2f obj1direction, float obj1Speed, const sf::FloatRect obj1Bounds, sf::Vector2f obj1Acceleration, 
-                             const sf::Vector2f obj2position, const sf::Vector2f obj2direction, float obj2Speed, const sf::FloatRect obj2Bounds, sf::Vector2f obj2Acceleration);
+                             const sf::Vector2f obj2position, const sf::Vector2f obj2direction, float obj2Speed, const sf::FloatRect obj2Bounds, sf::Vector2f obj2Acceleration,
+                             float& timeToImpact);
+
+    /* Time of impact per sprite pair (order doesn't matter), so raycastPreCollision runs once per pair instead of every frame.
+    Only pairs headed for a hit get an entry; pairs that pass by or separate are never stored. An entry keeps the velocities it
+    was worked out from and only counts while both sprites still move that way; find() drops it as soon as either one turns,
+    changes speed or gets reused. collisionHelper drops it once its time comes. Entries of pairs nobody checks anymore go
+    through evictSprite() (pooled sprites when they're released) or evictBefore(). Every call locks, so collision checks can
+    run on several threads */
+    class TimeOfImpactCache {
+    public:
+        struct Impact {
+            float time {}; // absolute, closest approach
+            bool hits {}; // the bounds overlap at the closest approach, otherwise the pair passes by
+        };
+
+        // false if the pair has no entry, or one from other velocities (which gets dropped)
+        bool find(const Sprite* sprite1, const Sprite* sprite2, sf::Vector2f velocity1, sf::Vector2f velocity2, Impact& impact);
+        void store(const Sprite* sprite1, const Sprite* sprite2, sf::Vector2f velocity1, sf::Vector2f velocity2, Impact impact);
+        void evict(const Sprite* sprite1, const Sprite* sprite2);
+        void evictSprite(const Sprite* sprite); // for sprites about to be deleted
+        void evictBefore(float time); // drops impacts due before time
+        void clear();
+        size_t size() const;
+
+    private:
+        using PairKey = std::pair<const Sprite*, const Sprite*>; // lower address first
+        struct PairKeyHash {
+            size_t operator()(const PairKey& key) const { 
+                const size_t hash1 = std::hash<const Sprite*>{}(key.first);
+                return hash1 ^ (std::hash<const Sprite*>{}(key.second) + 0x9e3779b97f4a7c15ull + (hash1 << 6) + (hash1 >> 2)); 
+            }
+        };
+        static PairKey makeKey(const Sprite* sprite1, const Sprite* sprite2) { return sprite1 < sprite2 ? PairKey{ sprite1, sprite2 } : PairKey{ sprite2, sprite1 }; }
+
+        struct Entry {
+            Impact impact; // time on the same clock as the timeElapsed given to collisionHelper
+            sf::Vector2f velocity1; // of key.first
+            sf::Vector2f velocity2; // of key.second
+        };
+
+        mutable std::mutex mutex;
+        std::unordered_map<PairKey, Entry, PairKeyHash> impactTimes; 
+    };
+    extern TimeOfImpactCache timeOfImpactCache;
     bool boundingBoxCollision(const sf::Vector2f &position1, const sf::Vector2f& size1, const sf::Vector2f &position2, const sf::Vector2f& size2);
-    bool pixelPerfectCollision( const std::shared_ptr<sf::Uint8[]> &bitmask1, const sf::Vector2f &position1, const sf::Vector2f &size1,
-                                const std::shared_ptr<sf::Uint8[]> &bitmask2, const sf::Vector2f &position2, const sf::Vector2f &size2);  
+    inline sf::Vector2i toPixelPosition(const sf::Vector2f& position) {
+        return sf::Vector2i{ static_cast<int>(std::floor(position.x)), static_cast<int>(std::floor(position.y)) };
+    }
+    // true if any set bit of the two masks lands on the same world pixel; ANDs whole 64 bit words per row (AVX2 or SSE2 when
+    // the compiler targets them, plain words otherwise), after the early outs below pass
+    bool bitmasksOverlap(const Bitmask& bitmask1, const sf::Vector2i& position1, const Bitmask& bitmask2, const sf::Vector2i& position2);
+    // early outs only: opaque bounds, then the 32x32 and 8x8 block levels. false means the masks can't touch, true means maybe
+    bool bitmasksMayOverlap(const Bitmask& bitmask1, const sf::Vector2i& position1, const Bitmask& bitmask2, const sf::Vector2i& position2);
+    bool pixelPerfectCollision( const std::shared_ptr<Bitmask> &bitmask1, const sf::Vector2f &position1, const sf::Vector2f &size1,
+                                const std::shared_ptr<Bitmask> &bitmask2, const sf::Vector2f &position2, const sf::Vector2f &size2);  
+
+    // structure of arrays batches for testing against thousands of shapes (bullet waves and such) without going through
+    // extractCollisionData per pair. arrays are padded to a multiple of 8 with NaN, which fails every comparison, so the
+    // vector loops never need a tail
+    struct AABBBatch {
+        std::vector<float> left, top, right, bottom;
+
+        void clear();
+        void reserve(size_t capacity);
+        void add(const sf::FloatRect& bounds);
+        size_t size() const { return count; }
+    private:
+        size_t count {};
+    };
+
+    struct CircleBatch {
+        std::vector<float> x, y, radius;
+
+        void clear();
+        void reserve(size_t capacity);
+        void add(const sf::Vector2f& center, float radius);
+        size_t size() const { return count; }
+    private:
+        size_t count {};
+    };
+
+    // hits are bitsets, bit i of the words is element i of the batch; same overlap rules as the single pair versions above
+    inline size_t hitWords(size_t count) { return (count + 63) / 64; }
+    void boundingBoxCollisionBatch(const sf::FloatRect& bounds, const AABBBatch& batch, std::vector<uint64_t>& hits);
+    void circleCollisionBatch(const sf::Vector2f& center, float radius, const CircleBatch& batch, std::vector<uint64_t>& hits);
+    // many vs many: row i is hitWords(batch2.size()) words starting at i * hitWords(batch2.size()) and holds the hits of batch1[i]
+    void boundingBoxCollisionBatch(const AABBBatch& batch1, const AABBBatch& batch2, std::vector<uint64_t>& hits);
+    void circleCollisionBatch(const CircleBatch& batch1, const CircleBatch& batch2, std::vector<uint64_t>& hits);
+
+    template<typename Callback> 
+    void forEachHit(const uint64_t* hits, size_t words, Callback&& callback) { // callback(size_t index) for every set bit
+        for (size_t word = 0; word < words; ++word) {
+            for (uint64_t bits = hits[word]; bits; bits &= bits - 1) {
+                callback(word * 64 + static_cast<size_t>(__builtin_ctzll(bits)));
+            }
+        }
+    }
+    template<typename Callback> 
+    void forEachHit(const std::vector<uint64_t>& hits, Callback&& callback) { forEachHit(hits.data(), hits.size(), std::forward<Callback>(callback)); }
    
     struct CollisionData {
         sf::Vector2f position;
@@ -117,7 +441,8 @@ namespace physics{
         float speed;
         sf::Vector2f acceleration;
         sf::Vector2f size;
-        std::shared_ptr<sf::Uint8[]> bitmask; 
+        std::shared_ptr<Bitmask> bitmask; 
+        std::shared_ptr<Bitmask> unionBitmask; 
         sf::FloatRect bounds;
     };
 
@@ -144,13 +469,16 @@ namespace physics{
         }
 
         data.bitmask = sprite->getBitmask(sprite->getCurrIndex());
+        data.unionBitmask = sprite->getUnionBitmask();
         return data;
     }
 
+    // sprite vs. sprite takes the collision function, then the current time for raycastPreCollision
     template<typename ObjType1, typename ObjType2, typename... Args>
     bool collisionHelper(ObjType1&& obj1, ObjType2&& obj2, Args&&... args) {
-        auto getSprite = [](auto&& obj) -> auto& {
-            if constexpr (std::is_pointer_v<std::decay_t<decltype(obj)>>) return *obj;
+        auto getSprite = [](auto&& obj) -> auto& { // unique_ptr and Sprite* are used as is, pointers to unique_ptr get dereferenced
+            using ObjType = std::decay_t<decltype(obj)>;
+            if constexpr (std::is_pointer_v<ObjType> && !std::is_base_of_v<Sprite, std::remove_pointer_t<ObjType>>) return *obj;
             else return obj;
         };
 
@@ -174,11 +502,8 @@ namespace physics{
                     else return obj; };
                 auto& tileMap = getTileMap(obj2);
 
-                if constexpr (std::is_same_v<std::decay_t<decltype(tileMap)>, TileMap>) { // only checks entire tilemap block as a single object
-                    sf::Vector2f position2 = tileMap.getTileMapPosition();
-                    sf::Vector2f size2(tileMap.getTileWidth() * static_cast<float>(tileMap.getTileMapWidth()),
-                                       tileMap.getTileHeight() * static_cast<float>(tileMap.getTileMapHeight()));
-                    return boundingBoxCollision(data1.position, data1.size, position2, size2);
+                if constexpr (std::is_same_v<std::decay_t<decltype(tileMap)>, TileMap>) { // only the solid cells under the sprite
+                    return tileMap.overlapsSolid(sf::FloatRect(data1.position, data1.size));
                 }
                 return false;
             }
@@ -197,59 +522,68 @@ namespace physics{
 
             auto&& collisionFunc = std::get<0>(std::forward_as_tuple(std::forward<Args>(args)...));
 
-            Quadtree* quadtree = nullptr;
+            float timeElapsed = 0.0f; // current time (MetaComponents::globalTime), only used by raycastPreCollision
             if constexpr (sizeof...(Args) >= 2) {
-                quadtree = std::get<1>(std::forward_as_tuple(std::forward<Args>(args)...));
+                timeElapsed = std::get<1>(std::forward_as_tuple(std::forward<Args>(args)...));
             }
 
-            float timeElapsed = 0.0f;
-            if constexpr (sizeof...(Args) >= 3) {
-                timeElapsed = std::get<2>(std::forward_as_tuple(std::forward<Args>(args)...));
-            }
+            const Sprite* pairSprite1 = &*sprite1;
+            const Sprite* pairSprite2 = &*sprite2;
 
-            size_t counterIndex = 0;
-            if constexpr (sizeof...(Args) >= 4) {
-                counterIndex = std::get<3>(std::forward_as_tuple(std::forward<Args>(args)...));
-            }
-
-            auto collisionLambda = [&timeElapsed, counterIndex](const CollisionData& d1, const CollisionData& d2, auto&& func) {
+            auto collisionLambda = [timeElapsed, pairSprite1, pairSprite2](const CollisionData& d1, const CollisionData& d2, auto&& func) {
                 if constexpr (std::is_invocable_v<decltype(func), sf::Vector2f, float, sf::Vector2f, float>) {
                     return func(d1.position, d1.radius, d2.position, d2.radius);
                 } else if constexpr (std::is_invocable_v<decltype(func), sf::Vector2f, sf::Vector2f, sf::Vector2f, sf::Vector2f>) {
                     return func(d1.position, d1.size, d2.position, d2.size);
-                } else if constexpr (std::is_invocable_v<decltype(func), sf::Vector2f, sf::Vector2f, float, sf::FloatRect, sf::Vector2f>) {
-                    if (!cachedRaycastResult.counter) {
-                        return func(d1.position, d1.direction, d1.speed, d1.bounds, d1.acceleration,
-                                    d2.position, d2.direction, d2.speed, d2.bounds, d2.acceleration);
-                    } else if (timeElapsed > cachedRaycastResult.collisionTimes[counterIndex]) {
-                        cachedRaycastResult.counter = 0;
+                } else if constexpr (std::is_invocable_v<decltype(func), sf::Vector2f, sf::Vector2f, float, sf::FloatRect, sf::Vector2f,
+                                                                        sf::Vector2f, sf::Vector2f, float, sf::FloatRect, sf::Vector2f, float&>) {
+                    // already touching, whatever the cache says
+                    if (boundingBoxCollision(d1.position, d1.size, d2.position, d2.size)) {
+                        timeOfImpactCache.evict(pairSprite1, pairSprite2);
                         return true;
                     }
-                } else if constexpr (std::is_invocable_v<decltype(func), std::shared_ptr<sf::Uint8[]>, sf::Vector2f, sf::Vector2f,
-                                                                        std::shared_ptr<sf::Uint8[]>, sf::Vector2f, sf::Vector2f>) {
-                    return func(d1.bitmask, d1.position, d1.size, d2.bitmask, d2.position, d2.size);
-                }
-                return false;
-            };
-
-            if (quadtree) {
-                auto potentialColliders1 = quadtree->query(sprite1->returnSpritesShape().getGlobalBounds());
-                auto potentialColliders2 = quadtree->query(sprite2->returnSpritesShape().getGlobalBounds());
 
-                if (potentialColliders1.empty() || potentialColliders2.empty()) return false;
+                    // the time of impact is worked out once per pair and velocities, after that it's a lookup until the pair hits
+                    const sf::Vector2f velocity1 = d1.direction * d1.speed;
+                    const sf::Vector2f velocity2 = d2.direction * d2.speed;
+                    TimeOfImpactCache::Impact impact;
+                    if (!timeOfImpactCache.find(pairSprite1, pairSprite2, velocity1, velocity2, impact)) {
+                        float timeToImpact = 0.0f;
+                        if (!func(d1.position, d1.direction, d1.speed, d1.bounds, d1.acceleration,
+                                  d2.position, d2.direction, d2.speed, d2.bounds, d2.acceleration, timeToImpact) || timeToImpact < 0.0f) return false; // separating
 
-                for (const auto& collider1 : potentialColliders1) {
-                    for (const auto& collider2 : potentialColliders2) {
-                        if (collider1 == collider2) continue;
-                        if (collisionLambda(data1, data2, collisionFunc)) {
-                            return true;
-                        }
+                        // top left of sprite1 relative to sprite2's at the closest approach; it's only an impact if the boxes meet there
+                        const sf::Vector2f offset = d1.position - d2.position + (velocity1 - velocity2) * timeToImpact;
+                        impact.hits = offset.x > -d1.size.x && offset.x < d2.size.x && offset.y > -d1.size.y && offset.y < d2.size.y;
+                        impact.time = timeElapsed + timeToImpact;
+                        if (!impact.hits) return false; // passes by; only impacts still to come are kept
+                        timeOfImpactCache.store(pairSprite1, pairSprite2, velocity1, velocity2, impact);
                     }
+                    if (timeElapsed < impact.time) return false;
+                    timeOfImpactCache.evict(pairSprite1, pairSprite2); // due, it's either a hit now or the pair is past it
+                    return true;
+                } else if constexpr (std::is_invocable_v<decltype(func), std::shared_ptr<Bitmask>, sf::Vector2f, sf::Vector2f,
+                                                                        std::shared_ptr<Bitmask>, sf::Vector2f, sf::Vector2f>) {
+                    // the all-frames masks reject pairs that can't touch whichever frame either sprite is on
+                    if (d1.unionBitmask && d2.unionBitmask && 
+                        !bitmasksMayOverlap(*d1.unionBitmask, toPixelPosition(d1.position), *d2.unionBitmask, toPixelPosition(d2.position))) return false;
+                    return func(d1.bitmask, d1.position, d1.size, d2.bitmask, d2.position, d2.size);
                 }
                 return false;
-            } else {
-                return collisionLambda(data1, data2, collisionFunc);
-            }
+            };
+
+            return collisionLambda(data1, data2, collisionFunc);
         }
     }
+
+    // runs a narrowphase function (circleCollision, boundingBoxCollision, pixelPerfectCollision) on every pair the broadphase
+    // reports and calls onCollision(Sprite*, Sprite*) for the ones that hit. this is how many sprites get checked against each
+    // other; collisionHelper is for one pair that's already known. the broadphase only reports pairs whose bounds overlap now,
+    // so raycastPreCollision (impacts ahead of time) should go through collisionHelper for the pairs it's meant to watch
+    template<typename Partition, typename CollisionFunc, typename OnCollision>
+    void forEachCollidingPair(Partition& broadphase, CollisionFunc&& collisionFunc, OnCollision&& onCollision) {
+        broadphase.forEachPotentialPair([&](Sprite* sprite1, Sprite* sprite2) {
+            if (collisionHelper(sprite1, sprite2, collisionFunc)) onCollision(sprite1, sprite2);
+        });
+    }
 }    
\ No newline at end of file
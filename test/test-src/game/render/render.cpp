@@ -0,0 +1,428 @@
+//
+//  render.cpp
+//
+//
+
+#include "render.hpp"
+
+namespace render {
+
+    void SpriteBatch::clear() {
+        for (auto batch = batches.begin(); batch != batches.end(); ) {
+            if (batch->second.empty()) { // texture wasn't used last frame
+                batch = batches.erase(batch);
+            } else {
+                batch->second.clear();
+                ++batch;
+            }
+        }
+        spriteCount = 0;
+    }
+
+    // same quad sf::Sprite would draw: local rect through the sprite's transform, tex coords from the current frame's rect
+    void SpriteBatch::add(const Sprite& sprite, int layer) {
+        if (!sprite.getVisibleState()) return;
+
+        const sf::Sprite& shape = sprite.returnSpritesShape();
+        const sf::Texture* texture = shape.getTexture();
+        if (!texture) return;
+
+        addQuad(texture, sprite.isAnimated() ? sprite.getRects() : shape.getTextureRect(), shape.getTransform(), shape.getColor(), layer);
+    }
+
+    void SpriteBatch::addQuad(const sf::Texture* texture, const sf::IntRect& rect, const sf::Transform& transform, sf::Color color, int layer) {
+        if (!texture) return;
+
+        const float width = static_cast<float>(std::abs(rect.width));
+        const float height = static_cast<float>(std::abs(rect.height));
+        const float left = static_cast<float>(rect.left);
+        const float top = static_cast<float>(rect.top);
+        const float right = left + rect.width;
+        const float bottom = top + rect.height;
+
+        std::vector<sf::Vertex>& vertices = batches[{ layer, texture }];
+        vertices.emplace_back(transform.transformPoint(0.0f, 0.0f), color, sf::Vector2f(left, top));
+        vertices.emplace_back(transform.transformPoint(width, 0.0f), color, sf::Vector2f(right, top));
+        vertices.emplace_back(transform.transformPoint(width, height), color, sf::Vector2f(right, bottom));
+        vertices.emplace_back(transform.transformPoint(0.0f, height), color, sf::Vector2f(left, bottom));
+        ++spriteCount;
+    }
+
+    void SpriteBatch::drawLayer(sf::RenderTarget& target, int layer, sf::RenderStates states) const {
+        for (auto batch = batches.lower_bound({ layer, nullptr }); batch != batches.end() && batch->first.first == layer; ++batch) {
+            if (batch->second.empty()) continue;
+            states.texture = batch->first.second;
+            target.draw(batch->second.data(), batch->second.size(), sf::Quads, states);
+        }
+    }
+
+    void SpriteBatch::recordLayer(FrameSnapshot& frame, int layer) const {
+        for (auto batch = batches.lower_bound({ layer, nullptr }); batch != batches.end() && batch->first.first == layer; ++batch) {
+            if (!batch->second.empty()) frame.add(batch->second.data(), batch->second.size(), sf::Quads, batch->first.second);
+        }
+    }
+
+    void SpriteBatch::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+        for (const auto& [key, vertices] : batches) {
+            if (vertices.empty()) continue;
+            states.texture = key.second;
+            target.draw(vertices.data(), vertices.size(), sf::Quads, states);
+        }
+    }
+
+    size_t SpriteBatch::getBatchCount() const {
+        size_t count = 0;
+        for (const auto& [key, vertices] : batches) count += !vertices.empty();
+        return count;
+    }
+
+    void PositionInterpolator::track(Sprite& sprite) {
+        if (indices.count(&sprite)) return;
+        indices.emplace(&sprite, sprites.size());
+        sprites.push_back(&sprite);
+        previousPositions.push_back(sprite.getSpritePos());
+    }
+
+    void PositionInterpolator::untrack(const Sprite& sprite) {
+        auto found = indices.find(&sprite);
+        if (found == indices.end()) return;
+
+        const size_t index = found->second;
+        indices.erase(found);
+        if (index != sprites.size() - 1) {
+            sprites[index] = sprites.back();
+            previousPositions[index] = previousPositions.back();
+            indices[sprites[index]] = index;
+        }
+        sprites.pop_back();
+        previousPositions.pop_back();
+    }
+
+    void PositionInterpolator::clear() {
+        sprites.clear();
+        previousPositions.clear();
+        indices.clear();
+    }
+
+    void PositionInterpolator::beginStep() {
+        for (size_t i = 0; i < sprites.size(); ++i) previousPositions[i] = sprites[i]->getSpritePos();
+    }
+
+    void PositionInterpolator::teleport(const Sprite& sprite) {
+        auto found = indices.find(&sprite);
+        if (found != indices.end()) previousPositions[found->second] = sprite.getSpritePos();
+    }
+
+    void PositionInterpolator::apply(float alpha) const {
+        for (size_t i = 0; i < sprites.size(); ++i) {
+            const sf::Vector2f current = sprites[i]->getSpritePos();
+            sprites[i]->returnSpritesShape().setPosition(previousPositions[i] + (current - previousPositions[i]) * alpha);
+        }
+    }
+
+    void PositionInterpolator::restore() const {
+        for (Sprite* sprite : sprites) sprite->returnSpritesShape().setPosition(sprite->getSpritePos());
+    }
+
+    void FrameSnapshot::reset(const sf::View& newView, sf::Color newClearColor) {
+        view = newView;
+        clearColor = newClearColor;
+        vertices.clear();
+        commands.clear();
+        texts.clear();
+    }
+
+    void FrameSnapshot::add(const sf::Vertex* newVertices, size_t count, sf::PrimitiveType type, const sf::Texture* texture) {
+        if (!newVertices || count == 0) return;
+
+        // strips and fans would join up with the command before, everything else can share its draw call
+        const bool separable = type == sf::Quads || type == sf::Triangles || type == sf::Lines || type == sf::Points;
+        if (separable && !commands.empty()) {
+            Command& last = commands.back();
+            if (last.count > 0 && last.type == type && last.texture == texture && last.first + last.count == vertices.size()) {
+                vertices.insert(vertices.end(), newVertices, newVertices + count);
+                last.count += count;
+                return;
+            }
+        }
+        commands.push_back({ vertices.size(), count, type, texture });
+        vertices.insert(vertices.end(), newVertices, newVertices + count);
+    }
+
+    void FrameSnapshot::add(const Background& background) {
+        if (!background.getVisibleState()) return;
+
+        sf::Vertex quad[4];
+        for (size_t i = 0; i < background.getLayerCount(); ++i) {
+            const sf::Texture* texture = background.getLayerQuad(i, view, quad);
+            if (texture) add(quad, 4, sf::Quads, texture);
+        }
+    }
+
+    void FrameSnapshot::add(const sf::Text& text) {
+        commands.push_back({ texts.size(), 0, sf::Quads, nullptr });
+        texts.push_back(text);
+    }
+
+    void FrameSnapshot::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+        for (const Command& command : commands) {
+            if (command.count == 0) {
+                target.draw(texts[command.first], states);
+                continue;
+            }
+            states.texture = command.texture;
+            target.draw(vertices.data() + command.first, command.count, command.type, states);
+        }
+    }
+
+    bool FrameExchange::publish() {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this]() { return stopped || (!pending && !drawing); });
+        if (stopped) return false;
+
+        backIndex = 1 - backIndex; // the filled one becomes the front
+        pending = true;
+        condition.notify_all();
+        return true;
+    }
+
+    const FrameSnapshot* FrameExchange::acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this]() { return stopped || pending; });
+        if (stopped) return nullptr;
+
+        pending = false;
+        drawing = true;
+        return &frames[1 - backIndex];
+    }
+
+    void FrameExchange::release() {
+        std::lock_guard<std::mutex> lock(mutex);
+        drawing = false;
+        condition.notify_all();
+    }
+
+    void FrameExchange::stop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        condition.notify_all();
+    }
+
+    void FrameExchange::restart() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = false;
+        pending = false;
+        drawing = false;
+    }
+
+    int SkylinePacker::fitHeight(size_t index, sf::Vector2i size) const {
+        if (skyline[index].x + size.x > width) return -1;
+
+        int top = 0;
+        int widthLeft = size.x;
+        for (size_t segment = index; widthLeft > 0; ++segment) { // sits on the highest segment under it
+            if (segment == skyline.size()) return -1;
+            top = std::max(top, skyline[segment].y);
+            if (top + size.y > height) return -1;
+            widthLeft -= skyline[segment].width;
+        }
+        return top;
+    }
+
+    bool SkylinePacker::insert(sf::Vector2i size, sf::Vector2i& position) {
+        if (size.x <= 0 || size.y <= 0) return false;
+
+        size_t bestIndex = skyline.size();
+        int bestBottom = std::numeric_limits<int>::max();
+        int bestWidth = std::numeric_limits<int>::max();
+        for (size_t index = 0; index < skyline.size(); ++index) {
+            const int top = fitHeight(index, size);
+            if (top < 0) continue;
+            // lowest bottom edge wins, narrower segment breaks ties so wide gaps stay open for wide rects
+            if (top + size.y < bestBottom || (top + size.y == bestBottom && skyline[index].width < bestWidth)) {
+                bestIndex = index;
+                bestBottom = top + size.y;
+                bestWidth = skyline[index].width;
+                position = { skyline[index].x, top };
+            }
+        }
+        if (bestIndex == skyline.size()) return false;
+
+        // new segment on top of the rect, then cut away whatever it covers to its right
+        skyline.insert(skyline.begin() + bestIndex, Segment{ position.x, bestBottom, size.x });
+        const int right = position.x + size.x;
+        for (size_t index = bestIndex + 1; index < skyline.size(); ) {
+            if (skyline[index].x >= right) break;
+            const int covered = right - skyline[index].x;
+            if (covered >= skyline[index].width) {
+                skyline.erase(skyline.begin() + index);
+                continue;
+            }
+            skyline[index].x += covered;
+            skyline[index].width -= covered;
+            break;
+        }
+        for (size_t index = 0; index + 1 < skyline.size(); ) { // merge neighbours at the same height
+            if (skyline[index].y == skyline[index + 1].y) {
+                skyline[index].width += skyline[index + 1].width;
+                skyline.erase(skyline.begin() + index + 1);
+            } else {
+                ++index;
+            }
+        }
+
+        usedSize = { std::max(usedSize.x, right), std::max(usedSize.y, bestBottom) };
+        return true;
+    }
+
+    std::vector<std::shared_ptr<sf::Texture>> buildAtlases(const std::vector<sf::Image>& images, unsigned int maxSize, unsigned int padding, std::vector<AtlasPlacement>& placements) {
+        placements.assign(images.size(), AtlasPlacement{});
+        const int pageSize = static_cast<int>(std::min(maxSize, sf::Texture::getMaximumSize()));
+        const int pad = static_cast<int>(padding);
+
+        std::vector<size_t> order(images.size()); // tallest first, then widest, packs tighter than load order
+        for (size_t index = 0; index < order.size(); ++index) order[index] = index;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            const sf::Vector2u sizeA = images[a].getSize();
+            const sf::Vector2u sizeB = images[b].getSize();
+            return sizeA.y != sizeB.y ? sizeA.y > sizeB.y : sizeA.x > sizeB.x;
+        });
+
+        std::vector<SkylinePacker> packers;
+        for (size_t index : order) {
+            const sf::Vector2u imageSize = images[index].getSize();
+            // padding goes on the right and bottom of every image, the page edge covers the top and left
+            const sf::Vector2i paddedSize(static_cast<int>(imageSize.x) + pad, static_cast<int>(imageSize.y) + pad);
+            if (imageSize.x == 0 || imageSize.y == 0 || paddedSize.x > pageSize || paddedSize.y > pageSize) continue;
+
+            AtlasPlacement& placement = placements[index];
+            for (size_t page = 0; page < packers.size() && !placement.packed; ++page) {
+                if (packers[page].insert(paddedSize, placement.offset)) {
+                    placement.packed = true;
+                    placement.page = page;
+                }
+            }
+            if (!placement.packed) {
+                packers.emplace_back(pageSize, pageSize);
+                placement.packed = packers.back().insert(paddedSize, placement.offset);
+                placement.page = packers.size() - 1;
+            }
+        }
+
+        std::vector<sf::Image> pageImages(packers.size());
+        for (size_t page = 0; page < packers.size(); ++page) {
+            const sf::Vector2i used = packers[page].getUsedSize();
+            pageImages[page].create(static_cast<unsigned int>(used.x), static_cast<unsigned int>(used.y), sf::Color::Transparent);
+        }
+        for (size_t index = 0; index < images.size(); ++index) {
+            if (!placements[index].packed) continue;
+            const AtlasPlacement& placement = placements[index];
+            pageImages[placement.page].copy(images[index], static_cast<unsigned int>(placement.offset.x), static_cast<unsigned int>(placement.offset.y));
+        }
+
+        std::vector<std::shared_ptr<sf::Texture>> pages;
+        pages.reserve(pageImages.size());
+        for (const sf::Image& pageImage : pageImages) {
+            auto texture = std::make_shared<sf::Texture>();
+            if (!texture->loadFromImage(pageImage)) throw std::runtime_error("Failed to create atlas texture");
+            pages.push_back(texture);
+        }
+        return pages;
+    }
+
+    StaticLayerCache::StaticLayerCache(sf::Vector2f origin, sf::Vector2f cellSize, size_t columns, size_t rows, size_t maxTextures, CellRenderer renderer) 
+        : origin(origin), cellSize(cellSize), columns(columns), rows(rows), maxTextures(maxTextures), renderer(std::move(renderer)) {}
+
+    void StaticLayerCache::markDirty(size_t cell) {
+        auto cached = cells.find(cell);
+        if (cached != cells.end()) cached->second.dirty = true;
+    }
+
+    void StaticLayerCache::markAllDirty() {
+        for (auto& [cell, cached] : cells) cached.dirty = true;
+    }
+
+    sf::FloatRect StaticLayerCache::getCellBounds(size_t cell) const {
+        return { origin.x + (cell % columns) * cellSize.x, origin.y + (cell / columns) * cellSize.y, cellSize.x, cellSize.y };
+    }
+
+    // every texture is a full cell, so any of them can be reused for any cell
+    sf::RenderTexture* StaticLayerCache::acquireTexture(size_t cell) const {
+        std::unique_ptr<sf::RenderTexture> texture;
+        if (cells.size() < maxTextures) {
+            texture = std::make_unique<sf::RenderTexture>();
+            const unsigned int width = static_cast<unsigned int>(std::ceil(cellSize.x));
+            const unsigned int height = static_cast<unsigned int>(std::ceil(cellSize.y));
+            if (!texture->create(width, height)) return nullptr;
+        } else {
+            auto oldest = cells.end();
+            for (auto cached = cells.begin(); cached != cells.end(); ++cached) {
+                if (cached->second.lastDrawnFrame == frame) continue; // on screen right now
+                if (oldest == cells.end() || cached->second.lastDrawnFrame < oldest->second.lastDrawnFrame) oldest = cached;
+            }
+            if (oldest == cells.end()) return nullptr;
+            texture = std::move(oldest->second.texture);
+            cells.erase(oldest);
+        }
+
+        CachedCell& cached = cells[cell];
+        cached.texture = std::move(texture);
+        cached.dirty = true;
+        return cached.texture.get();
+    }
+
+    void StaticLayerCache::drawCell(sf::RenderTarget& target, size_t cell, sf::RenderStates states) const {
+        auto cached = cells.find(cell);
+        sf::RenderTexture* texture = cached != cells.end() ? cached->second.texture.get() : acquireTexture(cell);
+        if (!texture) {
+            renderer(target, cell);
+            ++stats.uncachedCells;
+            return;
+        }
+
+        CachedCell& entry = cells[cell];
+        const sf::FloatRect bounds = getCellBounds(cell);
+        if (entry.dirty) {
+            texture->setView(sf::View(bounds));
+            texture->clear(sf::Color::Transparent);
+            renderer(*texture, cell);
+            texture->display();
+            entry.dirty = false;
+            ++stats.renderedCells;
+        }
+        entry.lastDrawnFrame = frame;
+
+        const sf::Vector2f textureSize(texture->getSize());
+        const sf::Vertex quad[4] = {
+            sf::Vertex({ bounds.left, bounds.top }, { 0.0f, 0.0f }),
+            sf::Vertex({ bounds.left + bounds.width, bounds.top }, { textureSize.x, 0.0f }),
+            sf::Vertex({ bounds.left + bounds.width, bounds.top + bounds.height }, textureSize),
+            sf::Vertex({ bounds.left, bounds.top + bounds.height }, { 0.0f, textureSize.y }),
+        };
+        states.texture = &texture->getTexture();
+        target.draw(quad, 4, sf::Quads, states);
+        ++stats.compositedCells;
+    }
+
+    void StaticLayerCache::draw(sf::RenderTarget& target, sf::RenderStates states) const {
+        ++frame;
+        stats = Stats{};
+        if (!renderer || columns == 0 || rows == 0 || cellSize.x <= 0.0f || cellSize.y <= 0.0f) return;
+
+        const sf::View& view = target.getView();
+        sf::FloatRect viewRect(view.getCenter() - view.getSize() / 2.0f, view.getSize());
+        viewRect = states.transform.getInverse().transformRect(viewRect);
+
+        const float firstX = std::max(std::floor((viewRect.left - origin.x) / cellSize.x), 0.0f);
+        const float firstY = std::max(std::floor((viewRect.top - origin.y) / cellSize.y), 0.0f);
+        const float lastX = std::min(std::ceil((viewRect.left + viewRect.width - origin.x) / cellSize.x) - 1.0f, static_cast<float>(columns) - 1.0f);
+        const float lastY = std::min(std::ceil((viewRect.top + viewRect.height - origin.y) / cellSize.y) - 1.0f, static_cast<float>(rows) - 1.0f);
+        if (firstX > lastX || firstY > lastY) return;
+
+        for (size_t cellY = static_cast<size_t>(firstY); cellY <= static_cast<size_t>(lastY); ++cellY) {
+            for (size_t cellX = static_cast<size_t>(firstX); cellX <= static_cast<size_t>(lastX); ++cellX) {
+                drawCell(target, cellY * columns + cellX, states);
+            }
+        }
+    }
+}
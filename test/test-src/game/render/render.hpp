@@ -0,0 +1,224 @@
+//
+//  render.hpp
+//
+//
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <map>
+#include <utility>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+#include <unordered_map>
+#include <array>
+#include <mutex>
+#include <condition_variable>
+#include <SFML/Graphics.hpp>
+
+#include "../../test-assets/sprites/sprites.hpp"
+
+namespace render {
+
+    class FrameSnapshot; 
+
+    // collects sprites for a frame and draws every sprite sharing a texture (within a layer) as one vertex array, so the draw
+    // calls go with the number of textures instead of the number of sprites. layers draw in ascending order and other things
+    // (tilemaps, text) can be drawn between them with drawLayer(). within a layer, sprites on the same texture keep the order
+    // they were added in but the order between textures isn't defined, so anything that has to overlap a certain way needs
+    // its own layer. sprites that draw themselves in a special way (Background) should still be drawn directly
+    class SpriteBatch : public sf::Drawable {
+    public:
+        void clear(); // call at the start of every frame, keeps the allocations around
+        void add(const Sprite& sprite, int layer = 0); // skips invisible sprites and ones without a texture
+
+        template<typename SpriteType>
+        void add(const std::unique_ptr<SpriteType>& sprite, int layer = 0) { if (sprite) add(*sprite, layer); }
+
+        template<typename SpriteType>
+        void add(const std::vector<std::unique_ptr<SpriteType>>& sprites, int layer = 0) {
+            for (const auto& sprite : sprites) add(sprite, layer);
+        }
+
+        // a quad that isn't a Sprite (entities in systems::Registry), rect in texture pixels through transform like sf::Sprite
+        void addQuad(const sf::Texture* texture, const sf::IntRect& rect, const sf::Transform& transform, sf::Color color = sf::Color::White, int layer = 0);
+
+        void drawLayer(sf::RenderTarget& target, int layer, sf::RenderStates states = sf::RenderStates::Default) const;
+        void recordLayer(FrameSnapshot& frame, int layer) const; // same as drawLayer, into a snapshot
+
+        size_t getSpriteCount() const { return spriteCount; }
+        size_t getBatchCount() const; // non-empty batches, i.e. draw calls for draw()
+
+    private:
+        using BatchKey = std::pair<int, const sf::Texture*>; // layer, texture
+        std::map<BatchKey, std::vector<sf::Vertex>> batches; // 4 vertices per sprite
+        size_t spriteCount {};
+
+        void draw(sf::RenderTarget& target, sf::RenderStates states) const override; // every layer
+    };
+
+    // bottom-left skyline packer for one atlas page: keeps the top edge of everything placed so far as a list of segments
+    // and puts each rect where its top ends up lowest
+    class SkylinePacker {
+    public:
+        SkylinePacker(int width, int height) : width(width), height(height), skyline{ { 0, 0, width } } {}
+
+        bool insert(sf::Vector2i size, sf::Vector2i& position); // false when it doesn't fit anymore
+        sf::Vector2i getUsedSize() const { return usedSize; } // bottom right corner of everything placed
+
+    private:
+        struct Segment {
+            int x {};
+            int y {};
+            int width {};
+        };
+        int fitHeight(size_t index, sf::Vector2i size) const; // where the rect's top goes if placed at segment index, -1 if no fit
+
+        int width {};
+        int height {};
+        std::vector<Segment> skyline; // left to right, covers the whole width
+        sf::Vector2i usedSize {};
+    };
+
+    // caches static content as one render texture per grid cell, drawn once and then only composited. a cell gets drawn again
+    // when it's marked dirty (e.g. a tile in it changed). only cells under the view are kept up to date; when more than
+    // maxTextures are needed the least recently drawn cell's texture is reused, and past that cells are drawn straight to the
+    // target. cell index is row * columns + column, the same as TileMap chunks when the grids match
+    class StaticLayerCache : public sf::Drawable {
+    public:
+        using CellRenderer = std::function<void(sf::RenderTarget& target, size_t cell)>; // draws the cell in world coordinates
+
+        StaticLayerCache(sf::Vector2f origin, sf::Vector2f cellSize, size_t columns, size_t rows, size_t maxTextures, CellRenderer renderer);
+
+        void markDirty(size_t cell); 
+        void markAllDirty(); 
+
+        struct Stats { // from the last draw, for profiling
+            size_t compositedCells {};
+            size_t renderedCells {}; // drawn into a texture again this frame
+            size_t uncachedCells {}; // drawn straight to the target, out of textures
+        };
+        Stats getStats() const { return stats; }
+        size_t getCachedCount() const { return cells.size(); }
+
+    private:
+        struct CachedCell {
+            std::unique_ptr<sf::RenderTexture> texture;
+            bool dirty = true;
+            size_t lastDrawnFrame {};
+        };
+
+        sf::FloatRect getCellBounds(size_t cell) const; 
+        sf::RenderTexture* acquireTexture(size_t cell) const; // null if none can be made or freed this frame
+        void drawCell(sf::RenderTarget& target, size_t cell, sf::RenderStates states) const; 
+
+        sf::Vector2f origin {};
+        sf::Vector2f cellSize {};
+        size_t columns {};
+        size_t rows {};
+        size_t maxTextures {};
+        CellRenderer renderer; 
+
+        // refreshed while drawing, which sf::Drawable makes const
+        mutable std::unordered_map<size_t, CachedCell> cells; 
+        mutable size_t frame {}; 
+        mutable Stats stats; 
+
+        void draw(sf::RenderTarget& target, sf::RenderStates states) const override; 
+    };
+
+    // for a fixed simulation step: remembers where tracked sprites were before the last step so they can be drawn partway
+    // between that and where they are now. only the drawn shape moves, getSpritePos() keeps the simulated position, and
+    // restore() puts the shapes back before the next step. sprites have to be untracked before they're destroyed
+    class PositionInterpolator {
+    public:
+        void track(Sprite& sprite); 
+        void untrack(const Sprite& sprite); 
+        void clear(); 
+
+        void beginStep(); // before every simulation step
+        void teleport(const Sprite& sprite); // after moving a sprite somewhere new in one go, so it doesn't slide there
+        void apply(float alpha) const; // 0 draws at the previous step, 1 at the current one
+        void restore() const; 
+
+    private:
+        std::vector<Sprite*> sprites; 
+        std::vector<sf::Vector2f> previousPositions; // lines up with sprites
+        std::unordered_map<const Sprite*, size_t> indices; 
+    };
+
+    // everything a frame draws, copied out of the scene so another thread can draw it while the scene moves on: vertices with
+    // the texture they use, and text. commands draw in the order they were added; textures (and text fonts) are only pointed
+    // at, so they have to outlive the snapshot and not change while it's drawn, which holds for the ones loaded at startup.
+    // draw() leaves the view alone, the one to draw with comes from getView()
+    class FrameSnapshot : public sf::Drawable {
+    public:
+        void reset(const sf::View& view, sf::Color clearColor = sf::Color::Black); // start of every frame, keeps the allocations
+        void setClearColor(sf::Color color) { clearColor = color; }
+
+        // copies the vertices. quads, triangles, lines and points on the same texture as the command before merge into it
+        void add(const sf::Vertex* vertices, size_t count, sf::PrimitiveType type, const sf::Texture* texture); 
+        void add(const sf::VertexArray& vertices, const sf::Texture* texture) { if (vertices.getVertexCount()) add(&vertices[0], vertices.getVertexCount(), vertices.getPrimitiveType(), texture); }
+        void add(const Background& background); // every layer over the snapshot's view
+        void add(const sf::Text& text); 
+
+        const sf::View& getView() const { return view; }
+        sf::Color getClearColor() const { return clearColor; }
+        size_t getCommandCount() const { return commands.size(); } // draw calls
+        size_t getVertexCount() const { return vertices.size(); }
+
+    private:
+        struct Command {
+            size_t first {}; // into vertices, or texts for text
+            size_t count {}; // 0 for text
+            sf::PrimitiveType type = sf::Quads; 
+            const sf::Texture* texture {}; 
+        };
+
+        sf::View view; 
+        sf::Color clearColor = sf::Color::Black; 
+        std::vector<sf::Vertex> vertices; 
+        std::vector<Command> commands; 
+        std::vector<sf::Text> texts; 
+
+        void draw(sf::RenderTarget& target, sf::RenderStates states) const override; 
+    };
+
+    // hands finished frames from the simulation thread to the render thread, two snapshots deep: the render thread draws one
+    // while the simulation fills the other. publish() waits for the render thread to be done with the frame it has and to
+    // have taken the last one, so the simulation runs at most a frame ahead and is paced by the render thread's display()
+    class FrameExchange {
+    public:
+        FrameSnapshot& back() { return frames[backIndex]; } // simulation thread, fill it and publish()
+        bool publish(); // false once stopped, the frame wasn't handed over
+
+        const FrameSnapshot* acquire(); // render thread, waits for a published frame. null once stopped
+        void release(); // render thread, after drawing what acquire() returned
+
+        void stop(); // wakes up both sides, acquire() returns null and publish() returns without handing anything over
+        void restart(); // before starting a new render thread
+
+    private:
+        std::array<FrameSnapshot, 2> frames; 
+        size_t backIndex {}; // the other one is the front, the render thread's
+        bool pending {}; // published, the render thread hasn't taken it yet
+        bool drawing {}; // the render thread has the front
+        bool stopped {}; 
+        std::mutex mutex; 
+        std::condition_variable condition; 
+    };
+
+    struct AtlasPlacement {
+        bool packed {}; // false if the image is bigger than a page, it keeps its own texture
+        size_t page {};
+        sf::Vector2i offset {}; // of the image's top left in the page
+    };
+
+    // packs whole images onto as few pages of at most maxSize x maxSize as it can, largest first, with padding pixels kept
+    // clear around each so smoothing doesn't bleed. pages are trimmed to what they use. placements line up with images
+    std::vector<std::shared_ptr<sf::Texture>> buildAtlases(const std::vector<sf::Image>& images, unsigned int maxSize, unsigned int padding, std::vector<AtlasPlacement>& placements);
+}
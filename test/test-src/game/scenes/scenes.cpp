@@ -7,13 +7,22 @@
 //////////////////////////////////////////////////////////////////////////////////////////////
 
 // Scene constructure sets up window and sprite respawn times 
-Scene::Scene( sf::RenderWindow& gameWindow ) : window(gameWindow), quadtree(0.0f, 0.0f, Constants::WORLD_WIDTH, Constants::WORLD_HEIGHT){ 
+Scene::Scene( sf::RenderWindow& gameWindow ) : window(gameWindow){ 
     MetaComponents::view = sf::View(Constants::VIEW_RECT); 
+    previousViewCenter = MetaComponents::view.getCenter(); 
     log_info("scene made"); 
 }
 
 void Scene::runScene() {
+    simulate(); 
+    present(1.0f); 
+}
+
+void Scene::simulate() {
     if (FlagSystem::flagEvents.gameEnd) return; // Early exit if game ended
+
+    interpolator.beginStep(); 
+    previousViewCenter = MetaComponents::view.getCenter(); 
     
     setTime();
 
@@ -26,7 +35,33 @@ void Scene::runScene() {
     handleSceneFlags();
 
     update();
+}
+
+void Scene::present(float alpha) {
+    if (FlagSystem::flagEvents.gameEnd) return; 
+
+    interpolator.apply(alpha); 
+    sf::View drawView = MetaComponents::view; 
+    drawView.setCenter(previousViewCenter + (MetaComponents::view.getCenter() - previousViewCenter) * alpha); 
+    window.setView(drawView); 
+
     draw();
+
+    interpolator.restore(); // collisions go by the shapes
+    window.setView(MetaComponents::view); 
+}
+
+void Scene::record(float alpha, render::FrameSnapshot& frame) {
+    if (FlagSystem::flagEvents.gameEnd) return; 
+
+    interpolator.apply(alpha); 
+    sf::View drawView = MetaComponents::view; 
+    drawView.setCenter(previousViewCenter + (MetaComponents::view.getCenter() - previousViewCenter) * alpha); 
+    frame.reset(drawView); 
+
+    recordFrame(frame);
+
+    interpolator.restore(); 
 }
 
 void Scene::draw(){
@@ -34,6 +69,10 @@ void Scene::draw(){
     window.display(); 
  }
 
+void Scene::recordFrame(render::FrameSnapshot& frame){
+    frame.setClearColor(sf::Color::Black); 
+}
+
 void Scene::moveViewPortWASD(){
     // move view port 
     if(FlagSystem::flagEvents.aPressed){
@@ -83,26 +122,84 @@ void gamePlayScene::createAssets() {
     try {
         globalTimer.Reset();  
 
+        broadphase = physics::makeBroadphase(Constants::GAMESCENE1_BROADPHASE); 
+
         // Initialize sprites and music here 
-        background = std::make_unique<Background>(Constants::BACKGROUND_POSITION, Constants::BACKGROUND_SCALE, Constants::BACKGROUND_TEXTURE);
+        std::vector<ParallaxLayer> backgroundLayers; 
+        for (size_t i = 0; i < Constants::BACKGROUND_LAYER_TEXTURES.size(); ++i) {
+            backgroundLayers.push_back({ Constants::BACKGROUND_LAYER_TEXTURES[i], Constants::BACKGROUND_LAYER_SPEED_FACTORS[i], Constants::BACKGROUND_LAYER_SCALES[i] });
+        }
+        background = std::make_unique<Background>(Constants::BACKGROUND_POSITION, backgroundLayers);
 
         player = std::make_unique<Player>(Constants::SPRITE1_POSITION, Constants::SPRITE1_SCALE, Constants::SPRITE1_TEXTURE, Constants::SPRITE1_SPEED, Constants::SPRITE1_ACCELERATION, 
                                           Constants::SPRITE1_ANIMATIONRECTS, Constants::SPRITE1_INDEXMAX, utils::convertToWeakPtrVector(Constants::SPRITE1_BITMASK));
         player->setRects(0); 
+        player->setUnionBitmask(Constants::SPRITE1_BITMASK_UNION); 
 
         backgroundMusic = std::make_unique<MusicClass>(std::move(Constants::BACKGROUNDMUSIC_MUSIC), Constants::BACKGROUNDMUSIC_VOLUME);
         if(backgroundMusic) backgroundMusic->returnMusic().play(); 
        
-        button1 = std::make_unique<Button>(Constants::BUTTON1_POSITION, Constants::BUTTON1_SCALE, Constants::BUTTON1_TEXTURE, 
-                                   Constants::BUTTON1_ANIMATIONRECTS, Constants::BUTTON1_INDEXMAX, 
-                                   utils::convertToWeakPtrVector(Constants::BUTTON1_BITMASK));
-        button1->setRects(0); 
+        // the button is plain components instead of a Button sprite; its rect comes from the animation clip below
+        registry.clear(); 
+        button1 = registry.create(); 
+        registry.add(button1, systems::TransformComponent{ Constants::BUTTON1_POSITION, Constants::BUTTON1_SCALE }); 
+        systems::RenderComponent buttonSprite; 
+        buttonSprite.texture = Constants::BUTTON1_TEXTURE.get(); 
+        buttonSprite.layer = 0; // under the tilemap
+        registry.add(button1, buttonSprite); 
+        const sf::IntRect buttonRect = Constants::BUTTON1_ANIMATIONRECTS.empty() ? sf::IntRect() : Constants::BUTTON1_ANIMATIONRECTS.front(); 
+        registry.add(button1, systems::ColliderComponent{ std::hypot(static_cast<float>(buttonRect.width), static_cast<float>(buttonRect.height)) / 2.0f, Constants::BUTTON1_BITMASK_UNION }); 
+
+        // every row of the player sheet is one clip, the first runs right and the second left
+        animationSystem = systems::AnimationSystem(); 
+        movementSystem = systems::MovementSystem(); 
+        const size_t playerFramesPerRow = Constants::SPRITE1_INDEXMAX / Constants::SPRITE1_ANIMATIONROWS; 
+        playerRunRightClip = animationSystem.addClip(Constants::SPRITE1_ANIMATIONRECTS, 0, playerFramesPerRow, Constants::SPRITE1_FRAME_TIME); 
+        playerRunLeftClip = Constants::SPRITE1_ANIMATIONROWS > 1 ? animationSystem.addClip(Constants::SPRITE1_ANIMATIONRECTS, playerFramesPerRow, playerFramesPerRow, Constants::SPRITE1_FRAME_TIME) : playerRunRightClip; 
+        playerAnimation = animationSystem.add(*player, playerRunRightClip); 
+        animationSystem.add(registry, button1, animationSystem.addClip(Constants::BUTTON1_ANIMATIONRECTS, 0, Constants::BUTTON1_INDEXMAX, Constants::BUTTON1_FRAME_TIME)); 
+        button1Body = std::make_unique<systems::ColliderBody>(registry, button1); // after the clip set its first rect
+
+        // every bullet is made here and reused, so firing doesn't allocate. pooled bullets stay in the animation system, paused
+        bulletPool = std::make_unique<utils::ObjectPool<Bullet>>(Constants::BULLET1_POOL_CAPACITY, []() {
+            auto bullet = std::make_unique<Bullet>(sf::Vector2f{}, Constants::BULLET1_SCALE, Constants::BULLET1_TEXTURE, Constants::BULLET1_SPEED, Constants::BULLET1_ACCELERATION, 
+                                                   Constants::BULLET1_ANIMATIONRECTS, Constants::BULLET1_INDEXMAX, utils::convertToWeakPtrVector(Constants::BULLET1_BITMASK));
+            bullet->setUnionBitmask(Constants::BULLET1_BITMASK_UNION); 
+            bullet->setVisibleState(false); 
+            bullet->setMoveState(false); 
+            return bullet; 
+        });
+        const auto bulletClip = animationSystem.addClip(Constants::BULLET1_ANIMATIONRECTS, 0, Constants::BULLET1_INDEXMAX, Constants::BULLET1_FRAME_TIME); 
+        animationSystem.reserve(animationSystem.size() + bulletPool->getCapacity()); 
+        movementSystem.reserve(bulletPool->getCapacity()); 
+        bulletAnimations.clear(); 
+        bulletMovers.clear(); 
+        interpolator.clear(); 
+        interpolator.track(*player); 
+        for (size_t i = 0; i < bulletPool->getCapacity(); ++i) {
+            bulletAnimations.push_back(animationSystem.add((*bulletPool)[i], bulletClip, false)); 
+            bulletMovers.push_back(movementSystem.add((*bulletPool)[i])); // stopped until fired
+            interpolator.track((*bulletPool)[i]); 
+        }
         
         // Initialize individual Tiles in the array
         for (int i = 0; i < Constants::TILES_NUMBER; ++i) {
             tiles1.at(i) = std::make_shared<Tile>(Constants::TILES_SCALE, Constants::TILES_TEXTURE, Constants::TILES_SINGLE_RECTS[i], Constants::TILES_BITMASKS[i], Constants::TILES_BOOLS[i]); 
         }
-        tileMap1 = std::make_unique<TileMap>(tiles1.data(), Constants::TILES_NUMBER, Constants::TILEMAP_WIDTH, Constants::TILEMAP_HEIGHT, Constants::TILE_WIDTH, Constants::TILE_HEIGHT, Constants::TILEMAP_FILEPATH, Constants::TILEMAP_POSITION); 
+        std::optional<TileMap::StreamingSettings> streamingSettings; 
+        if (Constants::TILEMAP_STREAMING) {
+            streamingSettings = TileMap::StreamingSettings{ Constants::TILEMAP_STREAM_LOAD_RADIUS, Constants::TILEMAP_STREAM_EVICT_RADIUS, 
+                                                            Constants::TILEMAP_STREAM_MAX_CHUNKS, Constants::TILEMAP_STREAM_MEMORY_BUDGET };
+        }
+        tileMap1 = std::make_unique<TileMap>(tiles1.data(), Constants::TILES_NUMBER, Constants::TILEMAP_WIDTH, Constants::TILEMAP_HEIGHT, Constants::TILE_WIDTH, Constants::TILE_HEIGHT, Constants::TILEMAP_FILEPATH, Constants::TILEMAP_POSITION, streamingSettings); 
+        if (Constants::STATIC_CACHE_ENABLED && Constants::RENDER_THREAD_ENABLED) {
+            log_info("static cache is off while the render thread is on, see render.render_thread in config.yaml"); 
+        }
+        if (Constants::STATIC_CACHE_ENABLED && !Constants::RENDER_THREAD_ENABLED) { // the render thread draws copied chunks instead
+            tileMapCache = std::make_unique<render::StaticLayerCache>(tileMap1->getTileMapPosition(), tileMap1->getChunkSize(), tileMap1->getChunkColumns(), tileMap1->getChunkRows(), 
+                                                                      Constants::STATIC_CACHE_MAX_TEXTURES, [this](sf::RenderTarget& target, size_t chunk) { tileMap1->drawChunk(target, chunk); });
+            tileMap1->setChunkChangedCallback([this](size_t chunk) { tileMapCache->markDirty(chunk); });
+        }
 
         playerJumpSound = std::make_unique<SoundClass>(Constants::PLAYERJUMP_SOUNDBUFF, Constants::PLAYERJUMPSOUND_VOLUME); 
           
@@ -110,7 +207,7 @@ void gamePlayScene::createAssets() {
         
         globalTimer.End("initializing assets in scene 1"); 
 
-        insertItemsInQuadtree(); 
+        insertItemsInBroadphase(); 
     } 
 
     catch (const std::exception& e) {
@@ -118,17 +215,54 @@ void gamePlayScene::createAssets() {
     }
 }
 
-void gamePlayScene::insertItemsInQuadtree(){
-    quadtree.insert(player);  
-    quadtree.insert(button1); 
+// pooled bullets go in once, free ones included, so firing never touches the broadphase's bookkeeping. free bullets are
+// disabled, which keeps them out of updates, queries and pairs until they're fired
+void gamePlayScene::insertItemsInBroadphase(){
+    broadphase->insert(player);  
+    if (button1Body) broadphase->insert(button1Body.get()); // static, so its bounds are the ones it has now
+    if (bulletPool) {
+        for (size_t i = 0; i < bulletPool->getCapacity(); ++i) {
+            Bullet* bullet = &(*bulletPool)[i]; 
+            broadphase->insert(bullet); 
+            broadphase->setEnabled(bullet, false); // none are out yet
+        }
+    }
 }
 
 void gamePlayScene::respawnAssets(){
-    // use existing sprites or make new ones with pre-made textures
+    // a click fires a bullet from the player toward it, if the pool has one left
+    if (!bulletPool || !player || !FlagSystem::flagEvents.mouseClicked) return; 
+
+    bulletPool->acquire([this](Bullet& bullet) {
+        bullet.changePosition(player->getSpritePos()); 
+        bullet.updatePos(); 
+        bullet.setDirectionVector(MetaComponents::mouseClickedPosition_i); 
+        bullet.setMoveState(true); 
+        bullet.setVisibleState(true); 
+
+        const size_t index = bulletPool->indexOf(&bullet); 
+        animationSystem.restart(bulletAnimations[index]); 
+        animationSystem.setPlaying(bulletAnimations[index], true); 
+        movementSystem.setPosition(bulletMovers[index], bullet.getSpritePos()); 
+        movementSystem.setDirection(bulletMovers[index], bullet.getDirectionVector()); 
+        movementSystem.setMoving(bulletMovers[index], true); 
+        interpolator.teleport(bullet); 
+        if (broadphase) broadphase->setEnabled(&bullet, true); // after moving it to the player, so it comes back with its new bounds
+    });
 } 
 
 void gamePlayScene::deleteInvisibleSprites() {
-    // maybe do a sprite pooling 
+    // bullets that left the screen go back to the pool
+    if (!bulletPool) return; 
+
+    bulletPool->releaseIf([](const Bullet& bullet) { return !bullet.getVisibleState(); }, [this](Bullet& bullet) {
+        const size_t index = bulletPool->indexOf(&bullet); 
+        bullet.setMoveState(false); 
+        animationSystem.setPlaying(bulletAnimations[index], false); 
+        movementSystem.setMoving(bulletMovers[index], false); 
+        physics::timeOfImpactCache.evictSprite(&bullet); // the slot comes back as a different bullet
+        if (broadphase) broadphase->setEnabled(&bullet, false); 
+    });
 }
 
 /* Updating time from GameManager's deltatime; it updates sprite respawn times and also counts 
@@ -150,19 +284,17 @@ void gamePlayScene::handleInput() {
 
 void gamePlayScene::handleMouseClick() {    
     if (FlagSystem::flagEvents.mouseClicked) {
-        if (button1->getVisibleState() && 
-            physics::collisionHelper(button1, MetaComponents::mouseClickedPosition_f)) {
+        if (registry.isAlive(button1) && registry.get<systems::RenderComponent>(button1).visible && 
+            systems::getBounds(registry, button1).contains(MetaComponents::mouseClickedPosition_f)) {
             log_info("button clicked");
 
-            button1->setClickedBool(true);
             FlagSystem::gameScene1Flags.sceneEnd = true;
             FlagSystem::gameSceneNextFlags.sceneStart = true;
             FlagSystem::gameSceneNextFlags.sceneEnd = false;
-
-            window.clear();
         }
         if (FlagSystem::gameScene1Flags.playerFalling){
             player->changePosition(Constants::SPRITE1_POSITION); 
+            interpolator.teleport(*player); 
         }
     }
 }
@@ -177,10 +309,6 @@ void gamePlayScene::handleSpaceKey() {
 }
 
 void gamePlayScene::handleMovementKeys() {
-    sf::FloatRect background1Bounds = background->getViewBounds(background->returnSpritesShape());
-    sf::FloatRect background2Bounds = background->getViewBounds(background->returnSpritesShape2());
-    sf::FloatRect viewBounds = MetaComponents::getViewBounds();
-
     // Left movement
     if (FlagSystem::flagEvents.aPressed) {
         if (!physics::collisionHelper(player, tileMap1) || player->getSpritePos().x > tileMap1->getTileMapPosition().x) {
@@ -204,17 +332,17 @@ void gamePlayScene::handleMovementKeys() {
         if (!physics::collisionHelper(player, tileMap1) || player->getSpritePos().y > tileMap1->getTileMapPosition().y) {
             physics::spriteMover(player, physics::moveUp);
         }
-        if (viewBounds.top > background1Bounds.top || viewBounds.top > background2Bounds.top) {
-           // MetaComponents::view.move(sf::Vector2f(0, -1));
-        }
     }
 }
 
 // Keeps sprites inside screen bounds, checks for collisions, update scores, and sets flagEvents.gameEnd to true in an event of collision 
 void gamePlayScene::handleGameEvents() { 
     if (player) physics::spriteMover(player, physics::moveRight); 
+    movementSystem.update(MetaComponents::deltaTime); // bullets
+    movementSystem.writeBack(); 
 
     FlagSystem::gameScene1Flags.playerFalling = !physics::collisionHelper(player, tileMap1) && !FlagSystem::gameScene1Flags.playerJumping; // player must be not colliding with the tilemap, and it must not be jumping
+    if (tileMap1->overlapsUnloaded(player->returnSpritesShape().getGlobalBounds())) FlagSystem::gameScene1Flags.playerFalling = false; // hold until the floor is streamed in
     FlagSystem::gameScene1Flags.playerJumping = (MetaComponents::spacePressedElapsedTime > 0); 
 } 
 
@@ -227,28 +355,45 @@ void gamePlayScene::update() {
         updateEntityStates();
         changeAnimation();
         updateDrawablesVisibility(); 
+        if (broadphase) broadphase->update(); 
+        handleSpriteCollisions(); // before deleting, so bullets used up this step go back to the pool right away
         deleteInvisibleSprites();
 
         updatePlayerAndView(); 
-        quadtree.update(); 
-
-        // Set the view for the window
-        window.setView(MetaComponents::view);
+        if (tileMap1) tileMap1->updateStreaming(MetaComponents::view.getCenter()); // only picks up chunks the loader already read
+        physics::timeOfImpactCache.evictBefore(MetaComponents::globalTime - MetaComponents::deltaTime); // impacts no collision check picked up last frame
+        // the window's view is set when drawing (present() or the render thread), the simulation only moves MetaComponents::view
         
     } catch (const std::exception& e) {
         log_error("Exception in updateSprites: " + std::string(e.what()));
     }
 }
 
+// one walk over the pairs the broadphase reports, each tested pixel by pixel. the button takes part through its
+// ColliderBody; a bullet that hits it is used up and goes back to the pool with the off-screen ones. pairs without the
+// button (the player and a bullet it just fired) don't do anything yet
+void gamePlayScene::handleSpriteCollisions(){
+    if (!broadphase || !button1Body || !button1Body->getVisibleState()) return; 
+
+    physics::forEachCollidingPair(*broadphase, physics::pixelPerfectCollision, [this](Sprite* sprite1, Sprite* sprite2) {
+        Sprite* other = sprite1 == button1Body.get() ? sprite2 : sprite2 == button1Body.get() ? sprite1 : nullptr; 
+        if (!other || other == player.get()) return; 
+        other->setVisibleState(false); // free bullets are disabled in the broadphase, so this is one that's out
+    });
+}
+
 void gamePlayScene::updateEntityStates(){ // manually change the sprite's state
     player->setJumpingState(FlagSystem::gameScene1Flags.playerJumping);
     player->setFallingState(FlagSystem::gameScene1Flags.playerFalling); 
 }
 
 void gamePlayScene::changeAnimation(){ // change animation for sprites. change animation for texts if necessary 
-    if (button1) button1->changeAnimation(); 
+    if (player && animationSystem.contains(playerAnimation)) {
+        animationSystem.setClip(playerAnimation, FlagSystem::flagEvents.aPressed ? playerRunLeftClip : playerRunRightClip); 
+    }
+    animationSystem.update(MetaComponents::deltaTime); // the player and bullets
+    animationSystem.update(registry, MetaComponents::deltaTime); // button1
     if (background) background->updateBackground(Constants::BACKGROUND_SPEED, Constants::BACKGROUND_MOVING_DIRECTION);
-    if (player) player->changeAnimation();
 }
 
 void gamePlayScene::updatePlayerAndView() {
@@ -264,7 +409,12 @@ void gamePlayScene::updatePlayerAndView() {
 
 void gamePlayScene::updateDrawablesVisibility(){
     try{
-        if (button1) button1->setVisibleState(physics::collisionHelper(button1, MetaComponents::view)); // set button's visibility if it is on or off screen 
+        if (registry.isAlive(button1)) { // set button's visibility if it is on or off screen 
+            const sf::FloatRect viewRect(MetaComponents::view.getCenter() - MetaComponents::view.getSize() / 2.0f, MetaComponents::view.getSize()); 
+            registry.get<systems::RenderComponent>(button1).visible = systems::getBounds(registry, button1).intersects(viewRect); 
+        }
+        if (button1Body) button1Body->sync(registry); // the frame and visibility just set, before the broadphase update
+        if (bulletPool) bulletPool->forEachActive([](Bullet& bullet) { bullet.setVisibleState(physics::collisionHelper(&bullet, MetaComponents::view)); }); // off screen ones get released
     }
     catch(const std::exception & e){
         log_error("Exception in updateDrawablesVisibility: " + std::string(e.what()));
@@ -280,14 +430,11 @@ void gamePlayScene::draw() {
             window.draw(*background); 
         }
 
-        if (button1 && button1->getVisibleState()) {
-            window.draw(*button1); 
-        }
-        if (tileMap1) window.draw(*tileMap1); 
-        
-        if (player && player->getVisibleState()) {
-            window.draw(*player); 
-        }
+        fillSpriteBatch(); 
+        spriteBatch.drawLayer(window, 0); 
+        if (tileMapCache) window.draw(*tileMapCache); 
+        else if (tileMap1) window.draw(*tileMap1); 
+        spriteBatch.drawLayer(window, 1); 
 
         if(text1) window.draw(*text1); 
 
@@ -299,6 +446,40 @@ void gamePlayScene::draw() {
     }
 }
 
+// the same frame as draw(), copied for the render thread. the tilemap's visible chunks get copied as well, since streaming
+// and tile edits change them while the frame is drawn; that skips the static cache, which only lives on the drawing thread
+void gamePlayScene::recordFrame(render::FrameSnapshot& frame) {
+    try {
+        frame.setClearColor(sf::Color::Blue); 
+
+        if (background) frame.add(*background); 
+
+        fillSpriteBatch(); 
+        spriteBatch.recordLayer(frame, 0); 
+        if (tileMap1) {
+            const sf::View& view = frame.getView(); 
+            const sf::Texture* tileset = tileMap1->getTilesetTexture(); 
+            tileMap1->forEachVisibleChunk(sf::FloatRect(view.getCenter() - view.getSize() / 2.0f, view.getSize()), 
+                                          [&frame, tileset](const sf::VertexArray& chunk) { frame.add(chunk, tileset); });
+        }
+        spriteBatch.recordLayer(frame, 1); 
+
+        if (text1 && text1->getVisibleState()) frame.add(text1->getText()); 
+    } 
+    
+    catch (const std::exception& e) {
+         log_error("Exception in recordFrame: " + std::string(e.what()));
+    }
+}
+
+// under the tilemap on layer 0, over it on layer 1
+void gamePlayScene::fillSpriteBatch() {
+    spriteBatch.clear(); 
+    systems::submitSprites(registry, spriteBatch); // button1, on layer 0
+    spriteBatch.add(player, 1); 
+    if (bulletPool) bulletPool->forEachActive([this](const Bullet& bullet) { spriteBatch.add(bullet, 1); }); 
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////////
 // Game Scene #2 from down below 
@@ -307,6 +488,8 @@ void gamePlayScene::draw() {
 
 void gamePlayScene2::createAssets() {
  try {
+        broadphase = physics::makeBroadphase(Constants::GAMESCENE2_BROADPHASE); 
+
         // Initialize sprites and music here 
         background = std::make_unique<Background>(Constants::BACKGROUND_POSITION, Constants::BACKGROUND_SCALE, Constants::BACKGROUND_TEXTURE2);
     } 
@@ -334,12 +517,14 @@ void gamePlayScene2::draw() {
     }
 }
 
+void gamePlayScene2::recordFrame(render::FrameSnapshot& frame) {
+    frame.setClearColor(sf::Color::Black); 
+    if (background) frame.add(*background); 
+}
+
 void gamePlayScene2::update() {
     try {
         deleteInvisibleSprites(); // do a sprite pooling or actually delete all
-
-        window.setView(MetaComponents::view); 
-        
     }
     catch (const std::exception& e) {
         log_error("Exception in updateSprites: " + std::string(e.what()));
@@ -19,6 +19,8 @@
 #include "../physics/physics.hpp"             
 #include "../camera/window.hpp"
 #include "../utils/utils.hpp"         
+#include "../render/render.hpp"
+#include "../systems/systems.hpp"
 
 // Base scene class 
 class Scene {
@@ -27,7 +29,10 @@ class Scene {
   virtual ~Scene() = default; 
 
   // base functions inside scene
-  void runScene();  
+  void runScene(); // one simulation step of deltaTime, then a draw
+  void simulate(); // one step of deltaTime without drawing, for the fixed step loop in GameManager
+  void present(float alpha); // draws alpha of the way from the previous step to the current one
+  void record(float alpha, render::FrameSnapshot& frame); // present() into a snapshot for the render thread, never touches the window
   virtual void createAssets(){}; 
 
  protected:
@@ -35,7 +40,7 @@ class Scene {
   FlagSystem::SceneEvents sceneEvents; // scene's own flag events
 
   // blank templates here
-  virtual void insertItemsInQuadtree(){}; 
+  virtual void insertItemsInBroadphase(){}; 
   virtual void deleteInvisibleSprites(){};  
 
   virtual void setTime(){}; 
@@ -50,12 +55,16 @@ class Scene {
 
   virtual void update(){};
   virtual void draw(); 
+  virtual void recordFrame(render::FrameSnapshot& frame); // what draw() draws, frame is reset to the view already
   virtual void moveViewPortWASD();
 
   void restartScene();
   void handleGameFlags(); 
 
-  physics::Quadtree quadtree; 
+  std::unique_ptr<physics::Broadphase> broadphase; // picked per scene in config.yaml, null until createAssets()
+  render::SpriteBatch spriteBatch; // refilled every draw
+  render::PositionInterpolator interpolator; // moving sprites, drawn between simulation steps
+  sf::Vector2f previousViewCenter; // the view gets blended the same way
 };
 
 // not in use
@@ -77,7 +86,7 @@ class gamePlayScene : public virtual Scene{
   void createAssets() override; 
 
  private:
-  void insertItemsInQuadtree() override; 
+  void insertItemsInBroadphase() override; 
 
   void handleInput() override; 
   void handleMouseClick(); 
@@ -95,23 +104,39 @@ class gamePlayScene : public virtual Scene{
   void update() override; 
   void updateDrawablesVisibility() override; 
   void updatePlayerAndView(); 
+  void handleSpriteCollisions(); 
   void updateEntityStates(); 
   void changeAnimation();
   
   void draw() override; 
+  void recordFrame(render::FrameSnapshot& frame) override; 
+  void fillSpriteBatch(); 
 
   std::unique_ptr<Background> background; 
   std::unique_ptr<Player> player; 
 
   std::array<std::shared_ptr<Tile>, Constants::TILES_NUMBER> tiles1;   
   std::unique_ptr<TileMap> tileMap1; 
+  std::unique_ptr<render::StaticLayerCache> tileMapCache; // null when the cache is off in config.yaml
 
-  std::unique_ptr<Button> button1;  
+  systems::Registry registry; // entities kept as components instead of Sprite objects, drawn through spriteBatch
+  systems::Entity button1 = systems::INVALID_ENTITY; 
+  std::unique_ptr<systems::ColliderBody> button1Body; // button1 as physics sees it
+  std::unique_ptr<utils::ObjectPool<Bullet>> bulletPool; // capacity from config.yaml
+  std::vector<systems::AnimationSystem::Handle> bulletAnimations; // by pool index
+  std::vector<systems::MovementSystem::Handle> bulletMovers; // by pool index
 
   std::unique_ptr<MusicClass> backgroundMusic;
   std::unique_ptr<SoundClass> playerJumpSound; 
 
   std::unique_ptr<TextClass> text1; 
+
+  // declared after the sprites it points at
+  systems::AnimationSystem animationSystem; 
+  systems::MovementSystem movementSystem; 
+  systems::AnimationSystem::ClipId playerRunRightClip {}; 
+  systems::AnimationSystem::ClipId playerRunLeftClip {}; 
+  systems::AnimationSystem::Handle playerAnimation = systems::AnimationSystem::INVALID_HANDLE; 
 };
 
 // not using right now in test game
@@ -126,6 +151,7 @@ public:
   void handleInput() override; 
 
   void draw() override; 
+  void recordFrame(render::FrameSnapshot& frame) override; 
   void update() override; 
 
   std::unique_ptr<Background> background; 
@@ -0,0 +1,563 @@
+//
+//  systems.cpp
+//
+//
+
+#include "systems.hpp"
+#include "../physics/physics.hpp"
+
+namespace systems {
+
+    Entity Registry::create() {
+        Entity entity;
+        if (!freeEntities.empty()) {
+            entity = freeEntities.back();
+            freeEntities.pop_back();
+        } else {
+            if (alive.size() >= INVALID_ENTITY) throw std::length_error("Too many entities.");
+            entity = static_cast<Entity>(alive.size());
+            alive.push_back(0);
+        }
+        alive[entity] = 1;
+        ++aliveCount;
+        return entity;
+    }
+
+    void Registry::destroy(Entity entity) {
+        if (!isAlive(entity)) return;
+        std::apply([entity](auto&... pool) { (pool.remove(entity), ...); }, pools);
+        alive[entity] = 0;
+        freeEntities.push_back(entity);
+        --aliveCount;
+    }
+
+    void Registry::reserve(size_t count) {
+        alive.reserve(count);
+        std::apply([count](auto&... pool) { (pool.reserve(count), ...); }, pools);
+    }
+
+    void Registry::clear() {
+        std::apply([](auto&... pool) { (pool.clear(), ...); }, pools);
+        alive.clear();
+        freeEntities.clear();
+        aliveCount = 0;
+    }
+
+    // the virtual getters get called once here instead of every frame
+    Entity Registry::createFromSprite(const Sprite& sprite, int layer) {
+        const Entity entity = create();
+        const sf::Sprite& shape = sprite.returnSpritesShape();
+
+        add(entity, TransformComponent{ shape.getPosition(), shape.getScale(), shape.getOrigin() });
+
+        RenderComponent renderComponent;
+        renderComponent.texture = shape.getTexture();
+        renderComponent.textureRect = sprite.isAnimated() ? sprite.getRects() : shape.getTextureRect();
+        renderComponent.color = shape.getColor();
+        renderComponent.layer = layer;
+        renderComponent.visible = sprite.getVisibleState();
+        add(entity, renderComponent);
+
+        ColliderComponent collider;
+        collider.radius = sprite.getRadius();
+        collider.bitmask = sprite.isAnimated() ? sprite.getUnionBitmask() : sprite.getBitmask(0);
+        add(entity, collider);
+
+        if (const NonStatic* mover = dynamic_cast<const NonStatic*>(&sprite)) {
+            add(entity, VelocityComponent{ mover->getDirectionVector(), mover->getSpeed(), mover->getAcceleration(), mover->getMoveState() });
+        }
+        return entity;
+    }
+
+    // same transform as sf::Transformable without rotation
+    void submitSprites(Registry& registry, render::SpriteBatch& batch) {
+        registry.each<RenderComponent, TransformComponent>([&batch](Entity, const RenderComponent& sprite, const TransformComponent& transform) {
+            if (!sprite.visible || !sprite.texture) return;
+            const sf::Transform quadTransform(transform.scale.x, 0.0f, transform.position.x - transform.origin.x * transform.scale.x,
+                                              0.0f, transform.scale.y, transform.position.y - transform.origin.y * transform.scale.y,
+                                              0.0f, 0.0f, 1.0f);
+            batch.addQuad(sprite.texture, sprite.textureRect, quadTransform, sprite.color, sprite.layer);
+        });
+    }
+
+    sf::FloatRect getBounds(const Registry& registry, Entity entity) {
+        const TransformComponent* transform = registry.getPool<TransformComponent>().find(entity);
+        const RenderComponent* sprite = registry.getPool<RenderComponent>().find(entity);
+        if (!transform || !sprite) return {};
+        return { transform->position.x - transform->origin.x * transform->scale.x, transform->position.y - transform->origin.y * transform->scale.y,
+                 sprite->textureRect.width * transform->scale.x, sprite->textureRect.height * transform->scale.y };
+    }
+
+    void ColliderBody::sync(const Registry& registry) {
+        const TransformComponent* transform = registry.getPool<TransformComponent>().find(entity);
+        const RenderComponent* render = registry.getPool<RenderComponent>().find(entity);
+        const ColliderComponent* collider = registry.getPool<ColliderComponent>().find(entity);
+        const VelocityComponent* velocity = registry.getPool<VelocityComponent>().find(entity);
+
+        visibleState = registry.isAlive(entity) && transform && render && render->visible;
+        if (transform && render) {
+            spriteCreated->setTextureRect(render->textureRect);
+            spriteCreated->setOrigin(transform->origin);
+            spriteCreated->setScale(transform->scale);
+            spriteCreated->setPosition(transform->position);
+            const sf::FloatRect bounds = spriteCreated->getGlobalBounds();
+            position = { bounds.left, bounds.top }; // collisionHelper reads the top left of sprites that aren't centered
+            scale = transform->scale;
+        }
+        radius = collider ? collider->radius : 0.0f;
+        bitmask = collider ? collider->bitmask : nullptr;
+        moving = velocity && velocity->moving;
+    }
+
+    AnimationSystem::ClipId AnimationSystem::addClip(const std::vector<sf::IntRect>& animationRects, size_t firstFrame, size_t frameCount, float frameDuration) {
+        if (frameCount == 0 || firstFrame + frameCount > animationRects.size()) {
+            throw std::out_of_range("Animation clip frames " + std::to_string(firstFrame) + " + " + std::to_string(frameCount) + " outside of " + std::to_string(animationRects.size()) + " animation rects.");
+        }
+        if (clips.size() >= std::numeric_limits<ClipId>::max()) {
+            throw std::length_error("Too many animation clips.");
+        }
+
+        Clip clip;
+        clip.firstFrame = static_cast<uint32_t>(frameRects.size());
+        clip.frameCount = static_cast<uint32_t>(frameCount);
+        clip.frameDuration = std::max(frameDuration, 0.0f);
+
+        for (size_t frame = firstFrame; frame < firstFrame + frameCount; ++frame) {
+            frameRects.push_back(animationRects[frame]);
+            frameIndices.push_back(static_cast<int>(frame));
+        }
+        clips.push_back(clip);
+        return static_cast<ClipId>(clips.size() - 1);
+    }
+
+    AnimationSystem::Handle AnimationSystem::add(Animated& sprite, ClipId clip, bool playing) {
+        if (clip >= clips.size()) {
+            throw std::out_of_range("Animation clip " + std::to_string(clip) + " doesn't exist.");
+        }
+
+        Handle handle;
+        if (!freeHandles.empty()) {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        } else {
+            handle = static_cast<Handle>(slots.size());
+            slots.push_back(INVALID_SLOT);
+        }
+
+        const uint32_t slot = static_cast<uint32_t>(entitySprites.size());
+        slots[handle] = slot;
+        entitySprites.push_back(&sprite);
+        entityClips.push_back(clip);
+        entityFrames.push_back(0);
+        entityTimers.push_back(0.0f);
+        entityPlaying.push_back(playing);
+        entityHandles.push_back(handle);
+
+        applyFrame(slot);
+        return handle;
+    }
+
+    void AnimationSystem::remove(Handle handle) {
+        const uint32_t slot = slotOf(handle);
+        const uint32_t last = static_cast<uint32_t>(entitySprites.size() - 1);
+
+        if (slot != last) { // move the last entity into the hole
+            entitySprites[slot] = entitySprites[last];
+            entityClips[slot] = entityClips[last];
+            entityFrames[slot] = entityFrames[last];
+            entityTimers[slot] = entityTimers[last];
+            entityPlaying[slot] = entityPlaying[last];
+            entityHandles[slot] = entityHandles[last];
+            slots[entityHandles[slot]] = slot;
+        }
+        entitySprites.pop_back();
+        entityClips.pop_back();
+        entityFrames.pop_back();
+        entityTimers.pop_back();
+        entityPlaying.pop_back();
+        entityHandles.pop_back();
+
+        slots[handle] = INVALID_SLOT;
+        freeHandles.push_back(handle);
+        changed.clear(); // slots in it may have moved
+    }
+
+    void AnimationSystem::clear() {
+        entitySprites.clear();
+        entityClips.clear();
+        entityFrames.clear();
+        entityTimers.clear();
+        entityPlaying.clear();
+        entityHandles.clear();
+        slots.clear();
+        freeHandles.clear();
+        changed.clear();
+    }
+
+    void AnimationSystem::setClip(Handle handle, ClipId clip) {
+        const uint32_t slot = slotOf(handle);
+        if (entityClips[slot] == clip) return;
+        if (clip >= clips.size()) {
+            throw std::out_of_range("Animation clip " + std::to_string(clip) + " doesn't exist.");
+        }
+
+        entityClips[slot] = clip;
+        entityFrames[slot] %= clips[clip].frameCount;
+        applyFrame(slot);
+    }
+
+    void AnimationSystem::setPlaying(Handle handle, bool playing) {
+        entityPlaying[slotOf(handle)] = playing;
+    }
+
+    void AnimationSystem::restart(Handle handle) {
+        const uint32_t slot = slotOf(handle);
+        entityFrames[slot] = 0;
+        entityTimers[slot] = 0.0f;
+        applyFrame(slot);
+    }
+
+    void AnimationSystem::reserve(size_t count) {
+        entitySprites.reserve(count);
+        entityClips.reserve(count);
+        entityFrames.reserve(count);
+        entityTimers.reserve(count);
+        entityPlaying.reserve(count);
+        entityHandles.reserve(count);
+        slots.reserve(count);
+        changed.reserve(count);
+    }
+
+    // a long frame can skip several animation frames, the remainder carries over so the rate stays right
+    bool AnimationSystem::advance(const Clip& clip, uint32_t& frame, float& timer, float deltaTime) {
+        timer += deltaTime;
+        if (timer < clip.frameDuration) return false;
+
+        uint32_t steps = 1;
+        if (clip.frameDuration > 0.0f) {
+            steps = static_cast<uint32_t>(timer / clip.frameDuration);
+            timer -= steps * clip.frameDuration;
+        } else {
+            timer = 0.0f;
+        }
+
+        const uint32_t nextFrame = (frame + steps % clip.frameCount) % clip.frameCount;
+        if (nextFrame == frame) return false;
+        frame = nextFrame;
+        return true;
+    }
+
+    void AnimationSystem::update(float deltaTime) {
+        changed.clear();
+
+        const size_t count = entitySprites.size();
+        for (size_t slot = 0; slot < count; ++slot) {
+            if (entityPlaying[slot] && advance(clips[entityClips[slot]], entityFrames[slot], entityTimers[slot], deltaTime)) {
+                changed.push_back(static_cast<uint32_t>(slot));
+            }
+        }
+
+        for (uint32_t slot : changed) {
+            applyFrame(slot);
+        }
+    }
+
+    void AnimationSystem::add(Registry& registry, Entity entity, ClipId clip, bool playing) {
+        if (clip >= clips.size()) {
+            throw std::out_of_range("Animation clip " + std::to_string(clip) + " doesn't exist.");
+        }
+        AnimationComponent animation;
+        animation.clip = clip;
+        animation.playing = playing;
+        registry.add(entity, animation);
+        if (RenderComponent* sprite = registry.getPool<RenderComponent>().find(entity)) {
+            sprite->textureRect = frameRects[clips[clip].firstFrame];
+        }
+    }
+
+    // the render lookup only happens for entities whose frame changed
+    void AnimationSystem::update(Registry& registry, float deltaTime) {
+        ComponentPool<AnimationComponent>& animations = registry.getPool<AnimationComponent>();
+        ComponentPool<RenderComponent>& sprites = registry.getPool<RenderComponent>();
+        AnimationComponent* states = animations.data();
+        const std::vector<Entity>& entities = animations.getEntities();
+
+        for (size_t index = 0; index < animations.size(); ++index) {
+            AnimationComponent& animation = states[index];
+            if (!animation.playing || animation.clip >= clips.size()) continue;
+
+            const Clip& clip = clips[animation.clip];
+            if (advance(clip, animation.frame, animation.timer, deltaTime)) {
+                if (RenderComponent* sprite = sprites.find(entities[index])) {
+                    sprite->textureRect = frameRects[clip.firstFrame + animation.frame];
+                }
+            }
+        }
+    }
+
+    uint32_t AnimationSystem::slotOf(Handle handle) const {
+        if (!contains(handle)) {
+            throw std::out_of_range("Animation handle " + std::to_string(handle) + " isn't in the animation system.");
+        }
+        return slots[handle];
+    }
+
+    void AnimationSystem::applyFrame(uint32_t slot) {
+        const size_t frame = clips[entityClips[slot]].firstFrame + entityFrames[slot];
+        entitySprites[slot]->setFrame(frameIndices[frame], frameRects[frame]);
+    }
+
+    MovementSystem::Handle MovementSystem::add(NonStatic& sprite, Mode mode) {
+        return addSlot(&sprite, INVALID_ENTITY, sprite.getSpritePos(), sprite.getDirectionVector(), sprite.getSpeed(), sprite.getAcceleration(), sprite.getMoveState(), mode);
+    }
+
+    MovementSystem::Handle MovementSystem::add(Registry& registry, Entity entity, Mode mode) {
+        const sf::Vector2f position = registry.get<TransformComponent>(entity).position;
+        const VelocityComponent velocity = registry.has<VelocityComponent>(entity) ? registry.get<VelocityComponent>(entity) : VelocityComponent{};
+        return addSlot(nullptr, entity, position, velocity.direction, velocity.speed, velocity.acceleration, velocity.moving, mode);
+    }
+
+    // new movers go on the end, which is the last mode's range, then get moved over to theirs
+    MovementSystem::Handle MovementSystem::addSlot(NonStatic* sprite, Entity entity, sf::Vector2f position, sf::Vector2f direction, float speed, sf::Vector2f acceleration, bool isMoving, Mode mode) {
+        Handle handle;
+        if (!freeHandles.empty()) {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        } else {
+            handle = static_cast<Handle>(slots.size());
+            slots.push_back(INVALID_SLOT);
+        }
+
+        const uint32_t slot = static_cast<uint32_t>(positionX.size());
+        positionX.push_back(position.x);
+        positionY.push_back(position.y);
+        directionX.push_back(direction.x);
+        directionY.push_back(direction.y);
+        speeds.push_back(speed);
+        accelerationX.push_back(acceleration.x);
+        accelerationY.push_back(acceleration.y);
+        targetX.push_back(position.x);
+        targetY.push_back(position.y);
+        jumpTimers.push_back(0.0f);
+        moving.push_back(isMoving ? 1.0f : 0.0f);
+        sprites.push_back(sprite);
+        entities.push_back(entity);
+        handles.push_back(handle);
+        slots[handle] = slot;
+        ++modeEnd[MODE_COUNT - 1];
+
+        moveToMode(slot, MODE_COUNT - 1, static_cast<size_t>(mode));
+        return handle;
+    }
+
+    void MovementSystem::remove(Handle handle) {
+        uint32_t slot = slotOf(handle);
+        slot = moveToMode(slot, modeOf(slot), MODE_COUNT - 1);
+        swapSlots(slot, static_cast<uint32_t>(positionX.size() - 1));
+
+        positionX.pop_back();
+        positionY.pop_back();
+        directionX.pop_back();
+        directionY.pop_back();
+        speeds.pop_back();
+        accelerationX.pop_back();
+        accelerationY.pop_back();
+        targetX.pop_back();
+        targetY.pop_back();
+        jumpTimers.pop_back();
+        moving.pop_back();
+        sprites.pop_back();
+        entities.pop_back();
+        handles.pop_back();
+        --modeEnd[MODE_COUNT - 1];
+
+        slots[handle] = INVALID_SLOT;
+        freeHandles.push_back(handle);
+    }
+
+    void MovementSystem::clear() {
+        for (auto* array : { &positionX, &positionY, &directionX, &directionY, &speeds, &accelerationX, &accelerationY, &targetX, &targetY, &jumpTimers, &moving }) {
+            array->clear();
+        }
+        sprites.clear();
+        entities.clear();
+        handles.clear();
+        slots.clear();
+        freeHandles.clear();
+        landed.clear();
+        std::fill(std::begin(modeEnd), std::end(modeEnd), 0);
+    }
+
+    void MovementSystem::reserve(size_t count) {
+        for (auto* array : { &positionX, &positionY, &directionX, &directionY, &speeds, &accelerationX, &accelerationY, &targetX, &targetY, &jumpTimers, &moving }) {
+            array->reserve(count);
+        }
+        sprites.reserve(count);
+        entities.reserve(count);
+        handles.reserve(count);
+        slots.reserve(count);
+    }
+
+    void MovementSystem::setMode(Handle handle, Mode mode) {
+        const uint32_t slot = slotOf(handle);
+        const uint32_t newSlot = moveToMode(slot, modeOf(slot), static_cast<size_t>(mode));
+        if (mode == Mode::Jump) jumpTimers[newSlot] = 0.0f;
+    }
+
+    void MovementSystem::setPosition(Handle handle, sf::Vector2f position) {
+        const uint32_t slot = slotOf(handle);
+        positionX[slot] = position.x;
+        positionY[slot] = position.y;
+    }
+
+    void MovementSystem::setDirection(Handle handle, sf::Vector2f direction) {
+        const uint32_t slot = slotOf(handle);
+        directionX[slot] = direction.x;
+        directionY[slot] = direction.y;
+    }
+
+    void MovementSystem::setTarget(Handle handle, sf::Vector2f target) {
+        const uint32_t slot = slotOf(handle);
+        targetX[slot] = target.x;
+        targetY[slot] = target.y;
+    }
+
+    void MovementSystem::setMoving(Handle handle, bool isMoving) {
+        moving[slotOf(handle)] = isMoving ? 1.0f : 0.0f;
+    }
+
+    MovementSystem::Mode MovementSystem::getMode(Handle handle) const {
+        return static_cast<Mode>(modeOf(slotOf(handle)));
+    }
+
+    sf::Vector2f MovementSystem::getPosition(Handle handle) const {
+        const uint32_t slot = slotOf(handle);
+        return { positionX[slot], positionY[slot] };
+    }
+
+    void MovementSystem::update(float deltaTime) {
+        float* const posX = positionX.data();
+        float* const posY = positionY.data();
+        float* const dirX = directionX.data();
+        float* const dirY = directionY.data();
+        const float* const speed = speeds.data();
+        const float* const accX = accelerationX.data();
+        const float* const accY = accelerationY.data();
+        const float* const move = moving.data();
+
+        // linear: followDirVec
+        const size_t linearEnd = modeEnd[static_cast<size_t>(Mode::Linear)];
+        for (size_t i = 0; i < linearEnd; ++i) {
+            const float step = speed[i] * deltaTime * move[i];
+            posX[i] += dirX[i] * step * accX[i];
+            posY[i] += dirY[i] * step * accY[i];
+        }
+
+        // follow: aim at the target, then the same step without going past it
+        const float* const tarX = targetX.data();
+        const float* const tarY = targetY.data();
+        const size_t followEnd = modeEnd[static_cast<size_t>(Mode::Follow)];
+        for (size_t i = linearEnd; i < followEnd; ++i) {
+            const float toTargetX = tarX[i] - posX[i];
+            const float toTargetY = tarY[i] - posY[i];
+            const float distance = std::sqrt(toTargetX * toTargetX + toTargetY * toTargetY);
+            const float inverse = distance > 0.0f ? 1.0f / distance : 0.0f;
+            dirX[i] = toTargetX * inverse;
+            dirY[i] = toTargetY * inverse;
+
+            const float step = speed[i] * deltaTime * move[i];
+            posX[i] += dirX[i] * std::min(step * accX[i], distance);
+            posY[i] += dirY[i] * std::min(step * accY[i], distance);
+        }
+
+        // gravity: freeFall
+        const size_t gravityEnd = modeEnd[static_cast<size_t>(Mode::Gravity)];
+        for (size_t i = followEnd; i < gravityEnd; ++i) {
+            posY[i] += speed[i] * deltaTime * physics::gravity * move[i];
+        }
+
+        // jump: the arc from physics::jump with its own timer per mover, few enough that branching is fine
+        constexpr float jumpDuration = 0.8f;
+        constexpr float halfJump = jumpDuration / 2.0f;
+        landed.clear();
+        const size_t jumpEnd = modeEnd[static_cast<size_t>(Mode::Jump)];
+        for (size_t i = gravityEnd; i < jumpEnd; ++i) {
+            if (move[i] == 0.0f) continue;
+
+            const float elapsed = jumpTimers[i] + deltaTime;
+            if (elapsed <= jumpDuration) {
+                const float rise = elapsed <= halfJump ? -(1.0f - elapsed / halfJump) : (elapsed - halfJump) / halfJump;
+                posY[i] += speed[i] * deltaTime * rise * accY[i] * physics::gravity;
+                jumpTimers[i] = elapsed;
+            } else {
+                jumpTimers[i] = 0.0f;
+                posY[i] = std::round(posY[i]); // same cleanup as physics::jump
+                landed.push_back(handles[i]);
+            }
+        }
+        for (Handle handle : landed) { // after the loop, switching modes moves slots around
+            setMode(handle, Mode::Linear);
+        }
+    }
+
+    // only movers that are moving, stopped ones (like pooled sprites) keep whatever was set on them
+    void MovementSystem::writeBack() {
+        for (size_t i = 0; i < sprites.size(); ++i) {
+            if (!sprites[i] || moving[i] == 0.0f) continue;
+            sprites[i]->changePosition({ positionX[i], positionY[i] });
+            sprites[i]->updatePos();
+        }
+    }
+
+    void MovementSystem::writeBack(Registry& registry) {
+        ComponentPool<TransformComponent>& transforms = registry.getPool<TransformComponent>();
+        for (size_t i = 0; i < entities.size(); ++i) {
+            if (entities[i] == INVALID_ENTITY || moving[i] == 0.0f) continue;
+            if (TransformComponent* transform = transforms.find(entities[i])) transform->position = { positionX[i], positionY[i] };
+        }
+    }
+
+    uint32_t MovementSystem::slotOf(Handle handle) const {
+        if (!contains(handle)) {
+            throw std::out_of_range("Movement handle " + std::to_string(handle) + " isn't in the movement system.");
+        }
+        return slots[handle];
+    }
+
+    size_t MovementSystem::modeOf(uint32_t slot) const {
+        size_t mode = 0;
+        while (slot >= modeEnd[mode]) ++mode;
+        return mode;
+    }
+
+    // one swap per range boundary crossed: to the edge of its range, then the boundary moves past it
+    uint32_t MovementSystem::moveToMode(uint32_t slot, size_t from, size_t to) {
+        while (from < to) {
+            const uint32_t last = static_cast<uint32_t>(modeEnd[from] - 1);
+            swapSlots(slot, last);
+            slot = last;
+            --modeEnd[from];
+            ++from;
+        }
+        while (from > to) {
+            const uint32_t first = static_cast<uint32_t>(modeBegin(from));
+            swapSlots(slot, first);
+            slot = first;
+            ++modeEnd[from - 1];
+            --from;
+        }
+        return slot;
+    }
+
+    void MovementSystem::swapSlots(uint32_t first, uint32_t second) {
+        if (first == second) return;
+        for (auto* array : { &positionX, &positionY, &directionX, &directionY, &speeds, &accelerationX, &accelerationY, &targetX, &targetY, &jumpTimers, &moving }) {
+            std::swap((*array)[first], (*array)[second]);
+        }
+        std::swap(sprites[first], sprites[second]);
+        std::swap(entities[first], entities[second]);
+        std::swap(handles[first], handles[second]);
+        slots[handles[first]] = first;
+        slots[handles[second]] = second;
+    }
+}
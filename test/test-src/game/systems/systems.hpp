@@ -0,0 +1,347 @@
+//
+//  systems.hpp
+//
+//
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <memory>
+#include <cmath>
+#include <iterator>
+#include <SFML/Graphics.hpp>
+
+#include "../../test-assets/sprites/sprites.hpp"
+#include "../render/render.hpp"
+
+namespace systems {
+
+    // entity/component storage, so entities can be plain data instead of the Sprite/NonStatic/Animated hierarchy. an entity
+    // is just an id; each component type lives in its own pool, packed so systems walk them front to back. ids are reused
+    // after destroy(), so don't keep them around past that
+    using Entity = uint32_t;
+    inline constexpr Entity INVALID_ENTITY = std::numeric_limits<Entity>::max();
+
+    struct TransformComponent {
+        sf::Vector2f position {};
+        sf::Vector2f scale { 1.0f, 1.0f };
+        sf::Vector2f origin {}; // in texture pixels, like sf::Sprite
+    };
+
+    struct VelocityComponent { // same meaning as NonStatic's
+        sf::Vector2f direction {};
+        float speed {};
+        sf::Vector2f acceleration {};
+        bool moving = true; // moveState
+    };
+
+    struct AnimationComponent { // advanced by AnimationSystem::update(Registry&, ...)
+        uint16_t clip {};
+        uint32_t frame {}; // within the clip
+        float timer {};
+        bool playing = true;
+    };
+
+    struct ColliderComponent {
+        float radius {}; // same as Sprite::getRadius
+        std::shared_ptr<Bitmask> bitmask; // union of every frame for animated sprites, shared with Constants
+    };
+
+    struct RenderComponent {
+        const sf::Texture* texture {};
+        sf::IntRect textureRect {};
+        sf::Color color = sf::Color::White;
+        int layer {}; // SpriteBatch layer
+        bool visible = true;
+    };
+
+    // sparse set: sparse maps entity -> index in the packed arrays, removal moves the last element into the hole. pools that
+    // get the same entities in the same order stay lined up, since Registry::destroy() removes from all of them together
+    template<typename Component>
+    class ComponentPool {
+    public:
+        static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+        Component& insert(Entity entity, Component component = {}) { // replaces the entity's component if it has one
+            if (contains(entity)) return components[sparse[entity]] = std::move(component);
+            if (entity >= sparse.size()) sparse.resize(static_cast<size_t>(entity) + 1, INVALID_INDEX);
+            sparse[entity] = static_cast<uint32_t>(components.size());
+            entities.push_back(entity);
+            components.push_back(std::move(component));
+            return components.back();
+        }
+
+        void remove(Entity entity) {
+            if (!contains(entity)) return;
+            const uint32_t index = sparse[entity];
+            const uint32_t last = static_cast<uint32_t>(components.size() - 1);
+            if (index != last) {
+                components[index] = std::move(components[last]);
+                entities[index] = entities[last];
+                sparse[entities[index]] = index;
+            }
+            components.pop_back();
+            entities.pop_back();
+            sparse[entity] = INVALID_INDEX;
+        }
+
+        bool contains(Entity entity) const { return entity < sparse.size() && sparse[entity] != INVALID_INDEX; }
+        Component* find(Entity entity) { return contains(entity) ? &components[sparse[entity]] : nullptr; }
+        const Component* find(Entity entity) const { return contains(entity) ? &components[sparse[entity]] : nullptr; }
+        Component& get(Entity entity) {
+            if (!contains(entity)) throw std::out_of_range("Entity " + std::to_string(entity) + " doesn't have this component.");
+            return components[sparse[entity]];
+        }
+
+        void reserve(size_t count) { components.reserve(count); entities.reserve(count); }
+        void clear() { components.clear(); entities.clear(); sparse.clear(); }
+
+        size_t size() const { return components.size(); }
+        Component* data() { return components.data(); }
+        const Component* data() const { return components.data(); }
+        const std::vector<Entity>& getEntities() const { return entities; } // lines up with data()
+
+    private:
+        std::vector<Component> components;
+        std::vector<Entity> entities;
+        std::vector<uint32_t> sparse;
+    };
+
+    class Registry {
+    public:
+        Entity create();
+        void destroy(Entity entity); // removes every component
+        bool isAlive(Entity entity) const { return entity < alive.size() && alive[entity]; }
+        size_t size() const { return aliveCount; }
+        void reserve(size_t count); // entities and every pool
+        void clear();
+
+        // copies what's in an existing sprite into components (transform, render, collider, and velocity for NonStatic ones),
+        // so a scene can move one kind of sprite over at a time. animation isn't copied since clips live in AnimationSystem
+        Entity createFromSprite(const Sprite& sprite, int layer = 0);
+
+        template<typename Component>
+        ComponentPool<Component>& getPool() { return std::get<ComponentPool<Component>>(pools); }
+        template<typename Component>
+        const ComponentPool<Component>& getPool() const { return std::get<ComponentPool<Component>>(pools); }
+
+        template<typename Component>
+        Component& add(Entity entity, Component component = {}) { return getPool<Component>().insert(entity, std::move(component)); }
+        template<typename Component>
+        void remove(Entity entity) { getPool<Component>().remove(entity); }
+        template<typename Component>
+        bool has(Entity entity) const { return getPool<Component>().contains(entity); }
+        template<typename Component>
+        Component& get(Entity entity) { return getPool<Component>().get(entity); }
+
+        // calls function(entity, First&, Rest&...) for every entity with all the components, walking First's pool in order.
+        // put the smallest pool first. where the other pools line up with First's (the same entity at the same packed index,
+        // which is how createFromSprite() and destroy() keep them) their components are read at that index, so the walk is
+        // straight through every pool; only entities out of line fall back to a sparse lookup. the function can change
+        // components but not add or remove them
+        template<typename First, typename... Rest, typename Function>
+        void each(Function&& function) {
+            ComponentPool<First>& first = getPool<First>();
+            First* components = first.data();
+            const std::vector<Entity>& entities = first.getEntities();
+            for (size_t index = 0; index < entities.size(); ++index) {
+                const Entity entity = entities[index];
+                if constexpr (sizeof...(Rest) > 0) {
+                    if ((inLine<Rest>(entity, index) && ...)) {
+                        function(entity, components[index], getPool<Rest>().data()[index]...);
+                        continue;
+                    }
+                    if (!(getPool<Rest>().contains(entity) && ...)) continue;
+                    function(entity, components[index], *getPool<Rest>().find(entity)...);
+                } else {
+                    function(entity, components[index]);
+                }
+            }
+        }
+
+    private:
+        template<typename Component>
+        bool inLine(Entity entity, size_t index) const {
+            const std::vector<Entity>& entities = getPool<Component>().getEntities();
+            return index < entities.size() && entities[index] == entity;
+        }
+
+        std::tuple<ComponentPool<TransformComponent>, ComponentPool<VelocityComponent>, ComponentPool<AnimationComponent>,
+                   ComponentPool<ColliderComponent>, ComponentPool<RenderComponent>> pools;
+        std::vector<uint8_t> alive;
+        std::vector<Entity> freeEntities;
+        size_t aliveCount {};
+    };
+
+    // adds every visible entity with a transform and render component to the batch (on its own layer)
+    void submitSprites(Registry& registry, render::SpriteBatch& batch);
+    // world rect of an entity as submitSprites draws it, like sf::Sprite::getGlobalBounds. empty without both components
+    sf::FloatRect getBounds(const Registry& registry, Entity entity);
+
+    /* stands in for an entity in physics, which only takes sprites: it can go in a broadphase and through collisionHelper
+    like any other sprite. sync() copies the entity's transform, rect and visibility into the shape; radius and bitmask come
+    from its ColliderComponent, so pixelPerfectCollision tests against the union mask. it's never drawn. a moving entity
+    (VelocityComponent) reports its moveState so broadphases refresh its bounds */
+    class ColliderBody : public Sprite {
+    public:
+        ColliderBody(const Registry& registry, Entity entity) : entity(entity) { sync(registry); }
+        void sync(const Registry& registry); // call after the entity's systems ran and before the broadphase update
+        Entity getEntity() const { return entity; }
+
+        float getRadius() const override { return radius; }
+        std::shared_ptr<Bitmask> const getBitmask(size_t) const override { return bitmask; }
+        std::shared_ptr<Bitmask> const getUnionBitmask() const override { return bitmask; }
+        bool getMoveState() const override { return moving; }
+        void draw(sf::RenderTarget&, sf::RenderStates) const override {}
+
+    private:
+        Entity entity;
+        std::shared_ptr<Bitmask> bitmask;
+        bool moving {};
+    };
+
+    // advances every registered sprite's animation in one loop instead of a changeAnimation() call per sprite. clips are
+    // ranges of a shared frame table (rect + the index into the sprite's animation rects) built once when the clip is added,
+    // and entity state (clip, frame, timer) is kept in parallel arrays. a sprite's rect is only set when its frame changes.
+    // the system holds plain pointers, so remove() a sprite before it's destroyed
+    class AnimationSystem {
+    public:
+        using ClipId = uint16_t;
+        using Handle = uint32_t;
+        static constexpr Handle INVALID_HANDLE = std::numeric_limits<Handle>::max();
+
+        // frames firstFrame .. firstFrame + frameCount - 1 of animationRects, each shown for frameDuration seconds
+        ClipId addClip(const std::vector<sf::IntRect>& animationRects, size_t firstFrame, size_t frameCount, float frameDuration);
+        size_t getClipCount() const { return clips.size(); }
+
+        Handle add(Animated& sprite, ClipId clip, bool playing = true); // shows the clip's first frame right away
+        void remove(Handle handle);
+        void clear(); // entities only, clips stay
+        bool contains(Handle handle) const { return handle < slots.size() && slots[handle] != INVALID_SLOT; }
+
+        // switching clips keeps the position within the clip (wrapped to the new length) and the timer, so a run cycle
+        // turning around doesn't restart. the new rect is set right away
+        void setClip(Handle handle, ClipId clip);
+        void setPlaying(Handle handle, bool playing);
+        void restart(Handle handle); // back to the clip's first frame, for pooled sprites getting reused
+        void reserve(size_t count); // entities
+
+        void update(float deltaTime);
+
+        // the same for entities in a registry: AnimationComponent is the state and RenderComponent's rect gets the frame
+        void add(Registry& registry, Entity entity, ClipId clip, bool playing = true);
+        void update(Registry& registry, float deltaTime);
+
+        size_t size() const { return entitySprites.size(); }
+        size_t getChangedCount() const { return changed.size(); } // sprites whose frame changed in the last update
+
+    private:
+        static constexpr uint32_t INVALID_SLOT = std::numeric_limits<uint32_t>::max();
+
+        struct Clip {
+            uint32_t firstFrame {}; // into the frame table
+            uint32_t frameCount {};
+            float frameDuration {};
+        };
+
+        static bool advance(const Clip& clip, uint32_t& frame, float& timer, float deltaTime); // true if the frame changed
+        uint32_t slotOf(Handle handle) const; // throws for handles that aren't in the system
+        void applyFrame(uint32_t slot);
+
+        std::vector<Clip> clips;
+        std::vector<sf::IntRect> frameRects; // the frame table, clips are ranges of it
+        std::vector<int> frameIndices; // index into the sprite's animation rects, for bitmask lookups
+
+        // one entry per entity, swap-removed so the loop never skips holes
+        std::vector<Animated*> entitySprites;
+        std::vector<ClipId> entityClips;
+        std::vector<uint32_t> entityFrames; // within the clip
+        std::vector<float> entityTimers;
+        std::vector<uint8_t> entityPlaying;
+        std::vector<Handle> entityHandles;
+
+        std::vector<uint32_t> slots; // handle -> entity slot, INVALID_SLOT for free handles
+        std::vector<Handle> freeHandles;
+        std::vector<uint32_t> changed; // slots, refilled every update
+    };
+
+    // integrates every mover at once instead of a spriteMover() call per sprite. position, direction, speed and acceleration
+    // are copied in when a mover is added and live in parallel arrays from then on, kept grouped by mode so each mode is one
+    // straight loop without branches. the math is the same as physics::followDirVec / freeFall / jump. positions only go
+    // back out in writeBack(), so anything that moves a sprite by itself has to setPosition() it here too. movers are either
+    // NonStatic sprites (remove() them before they're destroyed) or registry entities with a TransformComponent
+    class MovementSystem {
+    public:
+        enum class Mode : uint8_t {
+            Linear, // along the direction vector (moveLeft/Right/Up/Down are unit axis directions)
+            Follow, // turns toward its target point every step, then moves like Linear
+            Gravity, // falls at speed * gravity
+            Jump, // the jump arc on y, goes back to Linear once it lands
+        };
+        static constexpr size_t MODE_COUNT = 4;
+
+        using Handle = uint32_t;
+        static constexpr Handle INVALID_HANDLE = std::numeric_limits<Handle>::max();
+
+        Handle add(NonStatic& sprite, Mode mode = Mode::Linear);
+        Handle add(Registry& registry, Entity entity, Mode mode = Mode::Linear); // reads TransformComponent and VelocityComponent
+        void remove(Handle handle);
+        void clear();
+        void reserve(size_t count);
+        bool contains(Handle handle) const { return handle < slots.size() && slots[handle] != INVALID_SLOT; }
+
+        void setMode(Handle handle, Mode mode); // starting a jump restarts its arc
+        void setPosition(Handle handle, sf::Vector2f position);
+        void setDirection(Handle handle, sf::Vector2f direction);
+        void setTarget(Handle handle, sf::Vector2f target); // for Follow
+        void setMoving(Handle handle, bool moving); // moveState, a stopped mover keeps its place and mode
+
+        Mode getMode(Handle handle) const;
+        sf::Vector2f getPosition(Handle handle) const;
+
+        void update(float deltaTime);
+        void writeBack(); // positions into the sprites (changePosition + updatePos)
+        void writeBack(Registry& registry); // positions into the entities' TransformComponent
+
+        size_t size() const { return positionX.size(); }
+        size_t getModeCount(Mode mode) const { return modeEnd[static_cast<size_t>(mode)] - modeBegin(static_cast<size_t>(mode)); }
+
+    private:
+        static constexpr uint32_t INVALID_SLOT = std::numeric_limits<uint32_t>::max();
+
+        Handle addSlot(NonStatic* sprite, Entity entity, sf::Vector2f position, sf::Vector2f direction, float speed, sf::Vector2f acceleration, bool moving, Mode mode);
+        uint32_t slotOf(Handle handle) const; // throws for handles that aren't in the system
+        size_t modeBegin(size_t mode) const { return mode == 0 ? 0 : modeEnd[mode - 1]; }
+        size_t modeOf(uint32_t slot) const; 
+        uint32_t moveToMode(uint32_t slot, size_t from, size_t to); // returns the mover's new slot
+        void swapSlots(uint32_t first, uint32_t second);
+
+        // slots [modeBegin(m), modeEnd[m]) are in mode m
+        size_t modeEnd[MODE_COUNT] {};
+
+        std::vector<float> positionX;
+        std::vector<float> positionY;
+        std::vector<float> directionX;
+        std::vector<float> directionY;
+        std::vector<float> speeds;
+        std::vector<float> accelerationX;
+        std::vector<float> accelerationY;
+        std::vector<float> targetX;
+        std::vector<float> targetY;
+        std::vector<float> jumpTimers;
+        std::vector<float> moving; // 1 or 0, multiplied in so the loops don't branch on it
+        std::vector<NonStatic*> sprites; // null for registry entities
+        std::vector<Entity> entities; // INVALID_ENTITY for sprites
+        std::vector<Handle> handles;
+
+        std::vector<uint32_t> slots; // handle -> slot, INVALID_SLOT for free handles
+        std::vector<Handle> freeHandles;
+        std::vector<Handle> landed; // jumps that finished this update
+    };
+}
@@ -8,10 +8,114 @@
 
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
 
-/* utils namespace includes a convertToWeakPtrVector to convert shared_ptr vectors into weak_ptr vectors */
+/* utils namespace includes a convertToWeakPtrVector to convert shared_ptr vectors into weak_ptr vectors, and an ObjectPool
+for sprites that get spawned and despawned a lot */
 namespace utils {
     // for sprite consturction 
-    std::vector<std::weak_ptr<unsigned char[]>> convertToWeakPtrVector(const std::vector<std::shared_ptr<unsigned char[]>>& bitMask);
+    template<typename T>
+    std::vector<std::weak_ptr<T>> convertToWeakPtrVector(const std::vector<std::shared_ptr<T>>& bitMask) {
+        std::vector<std::weak_ptr<T>> result;
+        result.reserve(bitMask.size());  // Reserve memory to avoid reallocations
 
+        std::transform(bitMask.begin(), bitMask.end(), std::back_inserter(result),
+                       [](const std::shared_ptr<T>& ptr) {
+                           return std::weak_ptr<T>(ptr);  // Efficiently convert and move
+                       });
+
+        return result;
+    }
+
+    /* Fixed-size pool: every object gets made up front, and acquire()/release() only move indices between the free list and
+    the active list, so spawning never allocates. acquire() returns null once everything is out instead of growing. released
+    objects keep their state, so the reset passed to acquire() has to re-arm whatever matters (position, moveState, ...) */
+    template<typename T>
+    class ObjectPool {
+    public:
+        static constexpr size_t NOT_POOLED = SIZE_MAX;
+
+        template<typename Factory>
+        ObjectPool(size_t capacity, Factory&& makeObject) {
+            objects.reserve(capacity);
+            freeIndices.reserve(capacity);
+            active.reserve(capacity);
+            activeSlots.assign(capacity, NOT_POOLED);
+            indices.reserve(capacity);
+            for (size_t index = 0; index < capacity; ++index) {
+                objects.push_back(makeObject());
+                indices.emplace(objects.back().get(), index);
+            }
+            for (size_t index = capacity; index > 0; --index) freeIndices.push_back(index - 1); // hands out 0 first
+        }
+        ObjectPool(const ObjectPool&) = delete;
+        ObjectPool& operator=(const ObjectPool&) = delete;
+
+        // reset(T&) runs before the object is handed out
+        template<typename Reset>
+        T* acquire(Reset&& reset) {
+            if (freeIndices.empty()) return nullptr;
+            const size_t index = freeIndices.back();
+            freeIndices.pop_back();
+            activeSlots[index] = active.size();
+            active.push_back(index);
+            reset(*objects[index]);
+            return objects[index].get();
+        }
+        T* acquire() { return acquire([](T&) {}); }
+
+        bool release(const T* object) { // false if it isn't out of this pool
+            const size_t index = indexOf(object);
+            if (index == NOT_POOLED || activeSlots[index] == NOT_POOLED) return false;
+
+            const size_t slot = activeSlots[index];
+            active[slot] = active.back();
+            activeSlots[active[slot]] = slot;
+            active.pop_back();
+            activeSlots[index] = NOT_POOLED;
+            freeIndices.push_back(index);
+            return true;
+        }
+
+        // function(T&) for every object that's out. goes back to front, so it can release the object it's given
+        template<typename Function>
+        void forEachActive(Function&& function) {
+            for (size_t slot = active.size(); slot > 0; --slot) function(*objects[active[slot - 1]]);
+        }
+
+        // releases every active object the predicate is true for, calling onRelease(T&) on each first. returns how many
+        template<typename Predicate, typename OnRelease>
+        size_t releaseIf(Predicate&& predicate, OnRelease&& onRelease) {
+            size_t released = 0;
+            forEachActive([&](T& object) {
+                if (!predicate(object)) return;
+                onRelease(object);
+                release(&object);
+                ++released;
+            });
+            return released;
+        }
+
+        // stable for the pool's lifetime, for keeping per-object data next to the pool
+        size_t indexOf(const T* object) const {
+            auto found = indices.find(object);
+            return found == indices.end() ? NOT_POOLED : found->second;
+        }
+        T& operator[](size_t index) { return *objects[index]; }
+
+        size_t getCapacity() const { return objects.size(); }
+        size_t getActiveCount() const { return active.size(); }
+        size_t getFreeCount() const { return freeIndices.size(); }
+
+    private:
+        std::vector<std::unique_ptr<T>> objects;
+        std::vector<size_t> freeIndices;
+        std::vector<size_t> active; // indices of objects that are out
+        std::vector<size_t> activeSlots; // index -> position in active, NOT_POOLED when free
+        std::unordered_map<const T*, size_t> indices;
+    };
 }